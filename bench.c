@@ -0,0 +1,696 @@
+/*
+	Allocator benchmarks
+
+	Runs a set of fixed seed workloads against zloc and against the system allocator and reports ops/sec and latency
+	percentiles for every operation. Every run with the same seed and op count makes exactly the same sequence of
+	requests so results can be compared between builds.
+
+	bench.app [--ops count] [--seed seed] [--threads count] [--json file]
+
+	--ops		Number of operations per workload (default 1000000)
+	--seed		Seed for the random number generator (default 0x5EED)
+	--threads	Number of threads for the contention workload (default 4)
+	--json		Also write the results to a file as JSON so they can be tracked over time
+
+	Each operation is timed on its own, so the numbers include the cost of reading the clock. That overhead is measured
+	at start up and reported so it can be taken into account.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#define ZLOC_IMPLEMENTATION
+#define ZLOC_THREAD_SAFE
+#include "zloc.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#endif
+#include <pthread.h>
+
+#define bench__POOL_SIZE zloc__MEGABYTE(512)
+#define bench__MAX_LIVE 4096
+#define bench__RING_SIZE 1024
+#define bench__DEFAULT_SEED 0x5EED
+#define bench__DEFAULT_OPS 1000000
+#define bench__DEFAULT_THREADS 4
+#define bench__MAX_THREADS 64
+
+typedef unsigned long long bench_u64;
+
+//xorshift128+, the same generator tests.c uses but always seeded with a fixed value
+typedef struct bench_random {
+	bench_u64 seeds[2];
+} bench_random;
+
+static bench_u64 bench__next(bench_random *random) {
+	bench_u64 s1 = random->seeds[0];
+	bench_u64 s0 = random->seeds[1];
+	bench_u64 result = s0 + s1;
+	random->seeds[0] = s0;
+	s1 ^= s1 << 23;
+	random->seeds[1] = s1 ^ s0 ^ (s1 >> 18) ^ (s0 >> 5);
+	return result;
+}
+
+static void bench__seed(bench_random *random, bench_u64 seed) {
+	random->seeds[0] = seed ^ 0x9E3779B97F4A7C15ull;
+	random->seeds[1] = (seed + 1) * 0xBF58476D1CE4E5B9ull;
+	for (int i = 0; i != 16; ++i) {
+		bench__next(random);
+	}
+}
+
+static double bench__unit(bench_random *random) {
+	return (double)(bench__next(random) >> 11) / 9007199254740992.0;
+}
+
+static size_t bench__range(bench_random *random, size_t min, size_t max) {
+	return min + (size_t)(bench__next(random) % (max - min + 1));
+}
+
+static bench_u64 bench__now(void) {
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	if (!frequency.QuadPart) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	return (bench_u64)((double)counter.QuadPart * 1000000000.0 / (double)frequency.QuadPart);
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (bench_u64)now.tv_sec * 1000000000ull + (bench_u64)now.tv_nsec;
+#endif
+}
+
+//The allocator being measured. Both zloc and the system allocator are driven through this so the workloads are
+//identical for each.
+typedef struct bench_backend {
+	const char *name;
+	void *(*allocate)(size_t size);
+	void (*free)(void *allocation);
+	void *(*reallocate)(void *allocation, size_t size);
+	void *(*allocate_aligned)(size_t size, size_t alignment);
+	void (*free_aligned)(void *allocation);
+	void (*reset)(void);
+} bench_backend;
+
+static zloc_allocator *bench_allocator;
+static void *bench_pool_memory;
+
+static void *bench__zloc_allocate(size_t size) { return zloc_Allocate(bench_allocator, size); }
+static void bench__zloc_free(void *allocation) { zloc_Free(bench_allocator, allocation); }
+static void *bench__zloc_reallocate(void *allocation, size_t size) { return zloc_Reallocate(bench_allocator, allocation, size); }
+static void *bench__zloc_allocate_aligned(size_t size, size_t alignment) { return zloc_AllocateAligned(bench_allocator, size, alignment); }
+static void bench__zloc_reset(void) {
+	//Every workload starts with a fresh allocator on the same pool
+	bench_allocator = zloc_InitialiseAllocatorWithPool(bench_pool_memory, bench__POOL_SIZE);
+}
+
+static void *bench__malloc_allocate(size_t size) { return malloc(size); }
+static void bench__malloc_free(void *allocation) { free(allocation); }
+static void *bench__malloc_reallocate(void *allocation, size_t size) { return realloc(allocation, size); }
+#ifdef _WIN32
+static void *bench__malloc_allocate_aligned(size_t size, size_t alignment) { return _aligned_malloc(size, alignment); }
+static void bench__malloc_free_aligned(void *allocation) { _aligned_free(allocation); }
+#else
+static void *bench__malloc_allocate_aligned(size_t size, size_t alignment) {
+	void *allocation = 0;
+	return posix_memalign(&allocation, alignment, size) == 0 ? allocation : 0;
+}
+static void bench__malloc_free_aligned(void *allocation) { free(allocation); }
+#endif
+static void bench__malloc_reset(void) {}
+
+static const bench_backend bench_backends[] = {
+	{ "zloc", bench__zloc_allocate, bench__zloc_free, bench__zloc_reallocate, bench__zloc_allocate_aligned, bench__zloc_free, bench__zloc_reset },
+	{ "malloc", bench__malloc_allocate, bench__malloc_free, bench__malloc_reallocate, bench__malloc_allocate_aligned, bench__malloc_free_aligned, bench__malloc_reset },
+};
+
+typedef enum bench_op {
+	bench_op_allocate,
+	bench_op_free,
+	bench_op_reallocate,
+	bench_op_allocate_aligned,
+	bench_op_count
+} bench_op;
+
+static const char *bench_op_names[bench_op_count] = { "allocate", "free", "reallocate", "allocate_aligned" };
+
+//Raw latency samples for one operation, one sample per call
+typedef struct bench_samples {
+	bench_u64 *latencies;
+	size_t count;
+	size_t capacity;
+	size_t failed;
+} bench_samples;
+
+typedef struct bench_run {
+	bench_samples ops[bench_op_count];
+} bench_run;
+
+typedef struct bench_summary {
+	size_t count;
+	size_t failed;
+	double ops_per_second;
+	bench_u64 p50, p99, p999, max;
+} bench_summary;
+
+static void bench__init_run(bench_run *run, size_t capacity) {
+	for (int op = 0; op != bench_op_count; ++op) {
+		run->ops[op].latencies = (bench_u64*)malloc(capacity * sizeof(bench_u64));
+		run->ops[op].capacity = capacity;
+		run->ops[op].count = 0;
+		run->ops[op].failed = 0;
+	}
+}
+
+static void bench__free_run(bench_run *run) {
+	for (int op = 0; op != bench_op_count; ++op) {
+		free(run->ops[op].latencies);
+	}
+}
+
+static inline void bench__record(bench_run *run, bench_op op, bench_u64 start, bench_u64 end) {
+	bench_samples *samples = &run->ops[op];
+	if (samples->count < samples->capacity) {
+		samples->latencies[samples->count++] = end - start;
+	}
+}
+
+static int bench__compare_u64(const void *a, const void *b) {
+	bench_u64 x = *(const bench_u64*)a, y = *(const bench_u64*)b;
+	return x < y ? -1 : x > y;
+}
+
+static bench_u64 bench__percentile(const bench_samples *samples, double percentile) {
+	size_t index = (size_t)(percentile * (double)(samples->count - 1) + 0.5);
+	return samples->latencies[index];
+}
+
+static bench_summary bench__summarise(bench_samples *samples) {
+	bench_summary summary = { 0 };
+	summary.count = samples->count;
+	summary.failed = samples->failed;
+	if (!samples->count) {
+		return summary;
+	}
+	qsort(samples->latencies, samples->count, sizeof(bench_u64), bench__compare_u64);
+	bench_u64 total = 0;
+	for (size_t i = 0; i != samples->count; ++i) {
+		total += samples->latencies[i];
+	}
+	summary.ops_per_second = total ? (double)samples->count * 1000000000.0 / (double)total : 0.0;
+	summary.p50 = bench__percentile(samples, 0.5);
+	summary.p99 = bench__percentile(samples, 0.99);
+	summary.p999 = bench__percentile(samples, 0.999);
+	summary.max = samples->latencies[samples->count - 1];
+	return summary;
+}
+
+//Timed wrappers around the backend
+static void *bench__allocate(const bench_backend *backend, bench_run *run, size_t size) {
+	bench_u64 start = bench__now();
+	void *allocation = backend->allocate(size);
+	bench__record(run, bench_op_allocate, start, bench__now());
+	if (!allocation) run->ops[bench_op_allocate].failed++;
+	return allocation;
+}
+
+static void *bench__allocate_aligned(const bench_backend *backend, bench_run *run, size_t size, size_t alignment) {
+	bench_u64 start = bench__now();
+	void *allocation = backend->allocate_aligned(size, alignment);
+	bench__record(run, bench_op_allocate_aligned, start, bench__now());
+	if (!allocation) run->ops[bench_op_allocate_aligned].failed++;
+	return allocation;
+}
+
+static void *bench__reallocate(const bench_backend *backend, bench_run *run, void *allocation, size_t size) {
+	bench_u64 start = bench__now();
+	void *reallocation = backend->reallocate(allocation, size);
+	bench__record(run, bench_op_reallocate, start, bench__now());
+	if (!reallocation) run->ops[bench_op_reallocate].failed++;
+	return reallocation;
+}
+
+static void bench__free(const bench_backend *backend, bench_run *run, void *allocation, int aligned) {
+	bench_u64 start = bench__now();
+	if (aligned) {
+		backend->free_aligned(allocation);
+	} else {
+		backend->free(allocation);
+	}
+	bench__record(run, bench_op_free, start, bench__now());
+}
+
+//Touch the first and last byte so the allocation is actually used
+static inline void bench__touch(void *allocation, size_t size) {
+	if (allocation) {
+		((volatile char*)allocation)[0] = 1;
+		((volatile char*)allocation)[size - 1] = 1;
+	}
+}
+
+typedef struct bench_slot {
+	void *allocation;
+	size_t size;
+	int aligned;
+} bench_slot;
+
+static void bench__free_slots(const bench_backend *backend, bench_run *run, bench_slot *slots, int count) {
+	for (int i = 0; i != count; ++i) {
+		if (slots[i].allocation) {
+			bench__free(backend, run, slots[i].allocation, slots[i].aligned);
+			slots[i].allocation = 0;
+		}
+	}
+}
+
+/*
+	Uniform small: a fixed number of live slots, each op picks a slot at random and either frees what's in it or fills
+	it with a 16 - 256 byte allocation.
+*/
+static void bench__uniform_small(const bench_backend *backend, bench_run *run, size_t ops, bench_u64 seed) {
+	bench_random random;
+	bench__seed(&random, seed);
+	bench_slot slots[bench__MAX_LIVE] = { 0 };
+	for (size_t i = 0; i != ops; ++i) {
+		bench_slot *slot = &slots[bench__range(&random, 0, bench__MAX_LIVE - 1)];
+		if (slot->allocation) {
+			bench__free(backend, run, slot->allocation, 0);
+			slot->allocation = 0;
+		} else {
+			slot->size = bench__range(&random, 16, 256);
+			slot->allocation = bench__allocate(backend, run, slot->size);
+			bench__touch(slot->allocation, slot->size);
+		}
+	}
+	bench__free_slots(backend, run, slots, bench__MAX_LIVE);
+}
+
+/*
+	Power law: mostly small sizes with a long tail up to 1MB, roughly the shape of real program allocation sizes. One in
+	eight allocations asks for an alignment between 32 and 4096 bytes.
+*/
+static void bench__power_law(const bench_backend *backend, bench_run *run, size_t ops, bench_u64 seed) {
+	bench_random random;
+	bench__seed(&random, seed);
+	bench_slot slots[bench__MAX_LIVE] = { 0 };
+	for (size_t i = 0; i != ops; ++i) {
+		bench_slot *slot = &slots[bench__range(&random, 0, bench__MAX_LIVE - 1)];
+		if (slot->allocation) {
+			bench__free(backend, run, slot->allocation, slot->aligned);
+			slot->allocation = 0;
+		} else {
+			//Pareto distribution with alpha 1.1 and a minimum of 16 bytes
+			double u = 1.0 - bench__unit(&random);
+			double size = 16.0 * pow(u, -1.0 / 1.1);
+			slot->size = size > zloc__MEGABYTE(1) ? zloc__MEGABYTE(1) : (size_t)size;
+			slot->aligned = (bench__next(&random) & 7) == 0;
+			if (slot->aligned) {
+				size_t alignment = (size_t)32 << bench__range(&random, 0, 7);
+				slot->allocation = bench__allocate_aligned(backend, run, slot->size, alignment);
+			} else {
+				slot->allocation = bench__allocate(backend, run, slot->size);
+			}
+			bench__touch(slot->allocation, slot->size);
+		}
+	}
+	bench__free_slots(backend, run, slots, bench__MAX_LIVE);
+}
+
+/*
+	Realloc growth: a set of buffers that each grow by half again from 64 bytes up to a random cap between 4KB and 256KB,
+	like dynamic arrays being filled, and are then freed and started again.
+*/
+static void bench__realloc_growth(const bench_backend *backend, bench_run *run, size_t ops, bench_u64 seed) {
+	bench_random random;
+	bench__seed(&random, seed);
+	enum { buffer_count = 256 };
+	bench_slot slots[buffer_count] = { 0 };
+	size_t caps[buffer_count];
+	for (int i = 0; i != buffer_count; ++i) {
+		caps[i] = bench__range(&random, zloc__KILOBYTE(4), zloc__KILOBYTE(256));
+	}
+	for (size_t i = 0; i != ops; ++i) {
+		int index = (int)bench__range(&random, 0, buffer_count - 1);
+		bench_slot *slot = &slots[index];
+		if (!slot->allocation) {
+			slot->size = 64;
+			slot->allocation = bench__allocate(backend, run, slot->size);
+		} else if (slot->size >= caps[index]) {
+			bench__free(backend, run, slot->allocation, 0);
+			slot->allocation = 0;
+			caps[index] = bench__range(&random, zloc__KILOBYTE(4), zloc__KILOBYTE(256));
+			continue;
+		} else {
+			size_t size = slot->size + slot->size / 2;
+			void *allocation = bench__reallocate(backend, run, slot->allocation, size);
+			if (allocation) {
+				slot->allocation = allocation;
+				slot->size = size;
+			}
+		}
+		bench__touch(slot->allocation, slot->size);
+	}
+	bench__free_slots(backend, run, slots, buffer_count);
+}
+
+/*
+	Large realloc growth: a few buffers that each grow by half again from 1MB up to a random cap between 16MB and 64MB
+	and are then freed and started again. The buffers are grown in turn so they're usually in each other's way and have
+	to move, which makes this mostly a test of copying big blocks. Every op copies megabytes so only 1 in 2000 of the
+	ops asked for are run.
+*/
+static void bench__realloc_large(const bench_backend *backend, bench_run *run, size_t ops, bench_u64 seed) {
+	bench_random random;
+	bench__seed(&random, seed);
+	enum { buffer_count = 4 };
+	bench_slot slots[buffer_count] = { 0 };
+	size_t caps[buffer_count];
+	for (int i = 0; i != buffer_count; ++i) {
+		caps[i] = bench__range(&random, zloc__MEGABYTE(16), zloc__MEGABYTE(64));
+	}
+	ops = ops / 2000 + 1;
+	for (size_t i = 0; i != ops; ++i) {
+		int index = (int)(i % buffer_count);
+		bench_slot *slot = &slots[index];
+		if (!slot->allocation) {
+			slot->size = zloc__MEGABYTE(1);
+			slot->allocation = bench__allocate(backend, run, slot->size);
+		} else if (slot->size >= caps[index]) {
+			bench__free(backend, run, slot->allocation, 0);
+			slot->allocation = 0;
+			caps[index] = bench__range(&random, zloc__MEGABYTE(16), zloc__MEGABYTE(64));
+			continue;
+		} else {
+			size_t size = slot->size + slot->size / 2;
+			void *allocation = bench__reallocate(backend, run, slot->allocation, size);
+			if (allocation) {
+				slot->allocation = allocation;
+				slot->size = size;
+			}
+		}
+		bench__touch(slot->allocation, slot->size);
+	}
+	bench__free_slots(backend, run, slots, buffer_count);
+}
+
+/*
+	Allocate/free pairs: a short queue of live allocations where each op either frees the oldest or allocates into its slot, so
+	nearly every op goes through the size class mapping and free list search with very little else going on. Sizes are
+	log uniform between the bounds so that every first level class in the range gets about the same number of hits and
+	the class changes unpredictably from one op to the next.
+*/
+static void bench__pairs(const bench_backend *backend, bench_run *run, size_t ops, bench_u64 seed, size_t min_size, size_t max_size) {
+	bench_random random;
+	bench__seed(&random, seed);
+	enum { queue_size = 64 };
+	bench_slot slots[queue_size] = { 0 };
+	double range = log((double)max_size / (double)min_size);
+	for (size_t i = 0; i != ops; ++i) {
+		bench_slot *slot = &slots[i % queue_size];
+		if (slot->allocation) {
+			bench__free(backend, run, slot->allocation, 0);
+			slot->allocation = 0;
+			continue;
+		}
+		slot->size = (size_t)((double)min_size * exp(bench__unit(&random) * range));
+		slot->allocation = bench__allocate(backend, run, slot->size);
+		bench__touch(slot->allocation, slot->size);
+	}
+	bench__free_slots(backend, run, slots, queue_size);
+}
+
+static void bench__pairs_small(const bench_backend *backend, bench_run *run, size_t ops, bench_u64 seed) {
+	bench__pairs(backend, run, ops, seed, 8, 512);
+}
+
+static void bench__pairs_mixed(const bench_backend *backend, bench_run *run, size_t ops, bench_u64 seed) {
+	bench__pairs(backend, run, ops, seed, 8, zloc__KILOBYTE(256));
+}
+
+/*
+	Producer/consumer: one thread allocates messages of 32 - 2048 bytes and passes them through a ring buffer to a
+	second thread that frees them, so every free happens on a different thread to the allocation. The ring is guarded
+	by a mutex which is outside of the timed calls.
+*/
+typedef struct bench_ring {
+	void *messages[bench__RING_SIZE];
+	size_t head, tail;
+	int done;
+	pthread_mutex_t mutex;
+} bench_ring;
+
+typedef struct bench_thread {
+	const bench_backend *backend;
+	bench_run *run;
+	bench_ring *ring;
+	size_t ops;
+	bench_u64 seed;
+} bench_thread;
+
+static void *bench__producer(void *data) {
+	bench_thread *thread = (bench_thread*)data;
+	bench_random random;
+	bench__seed(&random, thread->seed);
+	size_t produced = 0;
+	while (produced != thread->ops) {
+		size_t size = bench__range(&random, 32, 2048);
+		void *message = bench__allocate(thread->backend, thread->run, size);
+		bench__touch(message, size);
+		for (;;) {
+			pthread_mutex_lock(&thread->ring->mutex);
+			if (thread->ring->head - thread->ring->tail < bench__RING_SIZE) {
+				thread->ring->messages[thread->ring->head++ % bench__RING_SIZE] = message;
+				pthread_mutex_unlock(&thread->ring->mutex);
+				break;
+			}
+			pthread_mutex_unlock(&thread->ring->mutex);
+		}
+		produced++;
+	}
+	pthread_mutex_lock(&thread->ring->mutex);
+	thread->ring->done = 1;
+	pthread_mutex_unlock(&thread->ring->mutex);
+	return 0;
+}
+
+static void *bench__consumer(void *data) {
+	bench_thread *thread = (bench_thread*)data;
+	for (;;) {
+		void *message = 0;
+		int done = 0;
+		pthread_mutex_lock(&thread->ring->mutex);
+		if (thread->ring->tail != thread->ring->head) {
+			message = thread->ring->messages[thread->ring->tail++ % bench__RING_SIZE];
+		} else {
+			done = thread->ring->done;
+		}
+		pthread_mutex_unlock(&thread->ring->mutex);
+		if (message) {
+			bench__free(thread->backend, thread->run, message, 0);
+		} else if (done) {
+			break;
+		}
+	}
+	return 0;
+}
+
+//Add the samples a thread recorded in its own run to the main one
+static void bench__merge_run(bench_run *run, const bench_run *thread_run) {
+	for (int op = 0; op != bench_op_count; ++op) {
+		bench_samples *samples = &run->ops[op];
+		for (size_t i = 0; i != thread_run->ops[op].count && samples->count < samples->capacity; ++i) {
+			samples->latencies[samples->count++] = thread_run->ops[op].latencies[i];
+		}
+		samples->failed += thread_run->ops[op].failed;
+	}
+}
+
+static void bench__producer_consumer(const bench_backend *backend, bench_run *run, size_t ops, bench_u64 seed) {
+	//Each thread records into its own run so the sample arrays aren't shared, then the frees are merged back in
+	bench_run consumer_run;
+	bench__init_run(&consumer_run, ops);
+	bench_ring ring;
+	memset(&ring, 0, sizeof(ring));
+	pthread_mutex_init(&ring.mutex, 0);
+	bench_thread producer = { backend, run, &ring, ops / 2, seed };
+	bench_thread consumer = { backend, &consumer_run, &ring, ops / 2, seed };
+	pthread_t threads[2];
+	pthread_create(&threads[0], 0, bench__producer, &producer);
+	pthread_create(&threads[1], 0, bench__consumer, &consumer);
+	pthread_join(threads[0], 0);
+	pthread_join(threads[1], 0);
+	pthread_mutex_destroy(&ring.mutex);
+	bench__merge_run(run, &consumer_run);
+	bench__free_run(&consumer_run);
+}
+
+/*
+	Contention: several threads all allocating and freeing 16 - 256 byte blocks from the same allocator as fast as they
+	can, each with its own set of live slots. Nearly all the time goes on waiting for the allocator's lock, so this is
+	the workload that shows how well the lock and the data it protects are kept apart.
+*/
+static size_t bench_thread_count = bench__DEFAULT_THREADS;
+
+static void *bench__contender(void *data) {
+	bench_thread *thread = (bench_thread*)data;
+	bench_random random;
+	bench__seed(&random, thread->seed);
+	enum { slot_count = 256 };
+	bench_slot slots[slot_count] = { 0 };
+	for (size_t i = 0; i != thread->ops; ++i) {
+		bench_slot *slot = &slots[bench__range(&random, 0, slot_count - 1)];
+		if (slot->allocation) {
+			bench__free(thread->backend, thread->run, slot->allocation, 0);
+			slot->allocation = 0;
+		} else {
+			slot->size = bench__range(&random, 16, 256);
+			slot->allocation = bench__allocate(thread->backend, thread->run, slot->size);
+			bench__touch(slot->allocation, slot->size);
+		}
+	}
+	bench__free_slots(thread->backend, thread->run, slots, slot_count);
+	return 0;
+}
+
+static void bench__contention(const bench_backend *backend, bench_run *run, size_t ops, bench_u64 seed) {
+	bench_run thread_runs[bench__MAX_THREADS];
+	bench_thread threads[bench__MAX_THREADS];
+	pthread_t thread_handles[bench__MAX_THREADS];
+	size_t ops_per_thread = ops / bench_thread_count;
+	for (size_t i = 0; i != bench_thread_count; ++i) {
+		//Room for the frees at the end as well
+		bench__init_run(&thread_runs[i], ops_per_thread + 256);
+		bench_thread thread = { backend, &thread_runs[i], 0, ops_per_thread, seed + i };
+		threads[i] = thread;
+		pthread_create(&thread_handles[i], 0, bench__contender, &threads[i]);
+	}
+	for (size_t i = 0; i != bench_thread_count; ++i) {
+		pthread_join(thread_handles[i], 0);
+		bench__merge_run(run, &thread_runs[i]);
+		bench__free_run(&thread_runs[i]);
+	}
+}
+
+typedef void (*bench_workload_function)(const bench_backend *backend, bench_run *run, size_t ops, bench_u64 seed);
+
+typedef struct bench_workload {
+	const char *name;
+	bench_workload_function function;
+} bench_workload;
+
+static const bench_workload bench_workloads[] = {
+	{ "uniform_small", bench__uniform_small },
+	{ "power_law", bench__power_law },
+	{ "producer_consumer", bench__producer_consumer },
+	{ "realloc_growth", bench__realloc_growth },
+	{ "realloc_large", bench__realloc_large },
+	{ "pairs_small", bench__pairs_small },
+	{ "pairs_mixed", bench__pairs_mixed },
+	{ "contention", bench__contention },
+};
+
+#define bench__COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+static bench_u64 bench__timer_overhead(void) {
+	bench_u64 lowest = (bench_u64)-1;
+	for (int i = 0; i != 10000; ++i) {
+		bench_u64 start = bench__now();
+		bench_u64 end = bench__now();
+		if (end - start < lowest) {
+			lowest = end - start;
+		}
+	}
+	return lowest;
+}
+
+int main(int argc, char **argv) {
+	size_t ops = bench__DEFAULT_OPS;
+	bench_u64 seed = bench__DEFAULT_SEED;
+	const char *json_path = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) {
+			ops = (size_t)strtoull(argv[++i], 0, 10);
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], 0, 0);
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			bench_thread_count = (size_t)strtoull(argv[++i], 0, 10);
+			if (bench_thread_count < 1 || bench_thread_count > bench__MAX_THREADS) {
+				printf("--threads must be between 1 and %d\n", bench__MAX_THREADS);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json_path = argv[++i];
+		} else {
+			printf("Usage: %s [--ops count] [--seed seed] [--threads count] [--json file]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	bench_pool_memory = malloc(bench__POOL_SIZE);
+	if (!bench_pool_memory) {
+		printf("Unable to allocate the pool for zloc\n");
+		return 1;
+	}
+	//Fault the pool in up front, a zloc pool is normally memory that the program already owns
+	memset(bench_pool_memory, 0, bench__POOL_SIZE);
+
+	FILE *json = 0;
+	if (json_path) {
+		json = fopen(json_path, "w");
+		if (!json) {
+			printf("Unable to open %s for writing\n", json_path);
+			return 1;
+		}
+	}
+
+	bench_u64 overhead = bench__timer_overhead();
+	printf("ops per workload: %zu, seed: %llu, contention threads: %zu, timer overhead: %lluns\n\n", ops, seed, bench_thread_count, overhead);
+	printf("%-18s %-8s %-17s %10s %14s %8s %8s %8s %10s\n", "workload", "backend", "operation", "count", "ops/sec", "p50", "p99", "p99.9", "max");
+	if (json) {
+		fprintf(json, "{\n\t\"ops\": %zu,\n\t\"seed\": %llu,\n\t\"threads\": %zu,\n\t\"timer_overhead_ns\": %llu,\n\t\"results\": [", ops, seed, bench_thread_count, overhead);
+	}
+
+	int first_result = 1;
+	for (size_t w = 0; w != bench__COUNT(bench_workloads); ++w) {
+		for (size_t b = 0; b != bench__COUNT(bench_backends); ++b) {
+			const bench_backend *backend = &bench_backends[b];
+			bench_run run;
+			bench__init_run(&run, ops);
+			backend->reset();
+			bench_u64 start = bench__now();
+			bench_workloads[w].function(backend, &run, ops, seed);
+			double seconds = (double)(bench__now() - start) / 1000000000.0;
+			for (int op = 0; op != bench_op_count; ++op) {
+				bench_summary summary = bench__summarise(&run.ops[op]);
+				if (!summary.count) {
+					continue;
+				}
+				printf("%-18s %-8s %-17s %10zu %14.0f %8llu %8llu %8llu %10llu%s\n", bench_workloads[w].name, backend->name, bench_op_names[op],
+					summary.count, summary.ops_per_second, summary.p50, summary.p99, summary.p999, summary.max, summary.failed ? " (failures)" : "");
+				if (json) {
+					fprintf(json, "%s\n\t\t{ \"workload\": \"%s\", \"backend\": \"%s\", \"operation\": \"%s\", \"count\": %zu, \"failed\": %zu, \"seconds\": %f, "
+						"\"ops_per_second\": %.0f, \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu }",
+						first_result ? "" : ",", bench_workloads[w].name, backend->name, bench_op_names[op], summary.count, summary.failed, seconds,
+						summary.ops_per_second, summary.p50, summary.p99, summary.p999, summary.max);
+					first_result = 0;
+				}
+			}
+			bench__free_run(&run);
+		}
+	}
+
+	if (json) {
+		fprintf(json, "\n\t]\n}\n");
+		fclose(json);
+	}
+	free(bench_pool_memory);
+	return 0;
+}
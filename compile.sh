@@ -1 +1,5 @@
-clang -g -fsanitize=address tests.c -o tests.app -pthread
+clang -g -fsanitize=address tests.c -o tests.app -pthread -lm
+clang++ -std=c++17 -g -fsanitize=address tests_cpp.cpp -o tests_cpp.app -pthread
+clang -O2 bench.c -o bench.app -pthread -lm
+clang -O2 replay.c -o replay.app -lm
+clang -O2 heapview.c -o heapview.app
@@ -0,0 +1,348 @@
+/*
+	Heap viewer
+
+	Reads heap dumps written with zloc_WriteHeapDump and prints a summary, converts them to JSON, renders them as a
+	fragmentation map or diffs two of them, for example:
+
+	clang -O2 heapview.c -o heapview.app
+	./heapview.app before.heap --html before.html
+	./heapview.app before.heap --diff after.heap
+
+	heapview.app dump_file [--json] [--html file] [--ppm file] [--width cells] [--diff other_dump_file]
+
+	--json		Print every block as JSON instead of the summary. With --diff the differences are printed as JSON
+	--html		Write a page with the fragmentation map drawn on a canvas and the summary underneath
+	--ppm		Write the fragmentation map as a binary PPM image
+	--width		Number of cells across the map (default 256). Each cell covers an equal slice of the pool and is shaded
+				by how much of it is in use: dark blue for free through to red for fully used, with block boundaries
+				that fall in the cell shown a little lighter so that lots of small blocks stand out
+	--diff		Compare against a second dump of the same pool and list the blocks that were added, removed or changed
+
+	Dumps of remote pools hold the remote offsets and sizes so they map the remote memory rather than the range pool.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ZLOC_IMPLEMENTATION
+#include "zloc.h"
+
+typedef struct heapview_dump {
+	zloc_heap_dump_header header;
+	zloc_heap_dump_block *blocks;
+} heapview_dump;
+
+typedef struct heapview_summary {
+	uint64_t used_bytes;
+	uint64_t free_bytes;
+	uint64_t largest_free_block;
+	uint64_t used_blocks;
+	uint64_t free_blocks;
+	double external_fragmentation;
+} heapview_summary;
+
+static int heapview__load(const char *path, heapview_dump *dump) {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		printf("Unable to open %s\n", path);
+		return 0;
+	}
+	if (fread(&dump->header, sizeof(dump->header), 1, file) != 1 || memcmp(dump->header.magic, ZLOC_HEAP_DUMP_MAGIC, sizeof(dump->header.magic)) != 0) {
+		printf("%s is not a zloc heap dump\n", path);
+		fclose(file);
+		return 0;
+	}
+	if (dump->header.version != ZLOC_HEAP_DUMP_VERSION) {
+		printf("%s was written by an incompatible version (version %u)\n", path, dump->header.version);
+		fclose(file);
+		return 0;
+	}
+	dump->blocks = (zloc_heap_dump_block*)malloc((size_t)dump->header.block_count * sizeof(zloc_heap_dump_block) + 1);
+	if (!dump->blocks || fread(dump->blocks, sizeof(zloc_heap_dump_block), (size_t)dump->header.block_count, file) != dump->header.block_count) {
+		printf("%s is truncated\n", path);
+		free(dump->blocks);
+		fclose(file);
+		return 0;
+	}
+	fclose(file);
+	return 1;
+}
+
+static void heapview__summarise(const heapview_dump *dump, heapview_summary *summary) {
+	memset(summary, 0, sizeof(*summary));
+	for (uint64_t i = 0; i != dump->header.block_count; ++i) {
+		const zloc_heap_dump_block *block = &dump->blocks[i];
+		if (block->flags & zloc_heap_dump_block_used) {
+			summary->used_bytes += block->size;
+			summary->used_blocks++;
+		} else {
+			summary->free_bytes += block->size;
+			summary->free_blocks++;
+			summary->largest_free_block = zloc__Max(summary->largest_free_block, block->size);
+		}
+	}
+	summary->external_fragmentation = summary->free_bytes ? 1.0 - (double)summary->largest_free_block / (double)summary->free_bytes : 0.0;
+}
+
+static void heapview__print_summary(const char *path, const heapview_dump *dump, const heapview_summary *summary) {
+	printf("dump:                     %s (%s pool, %llu bytes)\n", path, (dump->header.flags & zloc_heap_dump_remote) ? "remote" : "local", (unsigned long long)dump->header.pool_size);
+	printf("blocks:                   %llu used, %llu free\n", (unsigned long long)summary->used_blocks, (unsigned long long)summary->free_blocks);
+	printf("used bytes:               %llu (+%llu bytes of block headers)\n", (unsigned long long)summary->used_bytes, (unsigned long long)(dump->header.block_overhead * dump->header.block_count));
+	printf("free bytes:               %llu\n", (unsigned long long)summary->free_bytes);
+	printf("largest free block:       %llu\n", (unsigned long long)summary->largest_free_block);
+	printf("external fragmentation:   %.3f\n", summary->external_fragmentation);
+}
+
+static void heapview__print_block_json(const zloc_heap_dump_block *block) {
+	printf("{\"offset\": %llu, \"size\": %llu, \"used\": %s, \"tag\": %u}", (unsigned long long)block->offset, (unsigned long long)block->size,
+		(block->flags & zloc_heap_dump_block_used) ? "true" : "false", block->tag);
+}
+
+static void heapview__print_json(const heapview_dump *dump, const heapview_summary *summary) {
+	printf("{\n\t\"remote\": %s,\n\t\"pool_size\": %llu,\n\t\"block_overhead\": %llu,\n\t\"minimum_allocation_size\": %llu,\n",
+		(dump->header.flags & zloc_heap_dump_remote) ? "true" : "false", (unsigned long long)dump->header.pool_size,
+		(unsigned long long)dump->header.block_overhead, (unsigned long long)dump->header.minimum_allocation_size);
+	printf("\t\"used_bytes\": %llu,\n\t\"free_bytes\": %llu,\n\t\"largest_free_block\": %llu,\n\t\"external_fragmentation\": %.4f,\n",
+		(unsigned long long)summary->used_bytes, (unsigned long long)summary->free_bytes, (unsigned long long)summary->largest_free_block, summary->external_fragmentation);
+	printf("\t\"blocks\": [");
+	for (uint64_t i = 0; i != dump->header.block_count; ++i) {
+		printf(i ? ",\n\t\t" : "\n\t\t");
+		heapview__print_block_json(&dump->blocks[i]);
+	}
+	printf("\n\t]\n}\n");
+}
+
+/*
+	Splits the pool into width * height equal cells and works out how much of each cell is used and how many block
+	boundaries fall inside it. Blocks are in offset order so this is a single pass over the blocks.
+*/
+typedef struct heapview_cell {
+	float used;
+	unsigned int boundaries;
+} heapview_cell;
+
+static heapview_cell *heapview__build_map(const heapview_dump *dump, int width, int *height) {
+	uint64_t pool_size = zloc__Max(dump->header.pool_size, 1);
+	int rows = (int)zloc__Min(zloc__Max(width / 2, 1), (int)((pool_size + width - 1) / width));
+	*height = zloc__Max(rows, 1);
+	size_t cell_count = (size_t)width * (size_t)*height;
+	double cell_size = (double)pool_size / (double)cell_count;
+	heapview_cell *cells = (heapview_cell*)calloc(cell_count, sizeof(heapview_cell));
+	if (!cells) {
+		return 0;
+	}
+	for (uint64_t i = 0; i != dump->header.block_count; ++i) {
+		const zloc_heap_dump_block *block = &dump->blocks[i];
+		size_t first = zloc__Min((size_t)((double)block->offset / cell_size), cell_count - 1);
+		cells[first].boundaries++;
+		if (!(block->flags & zloc_heap_dump_block_used)) {
+			continue;
+		}
+		double start = (double)block->offset;
+		double end = (double)(block->offset + block->size);
+		for (size_t cell = first; cell < cell_count && (double)cell * cell_size < end; ++cell) {
+			double cell_start = zloc__Max((double)cell * cell_size, start);
+			double cell_end = zloc__Min((double)(cell + 1) * cell_size, end);
+			cells[cell].used += (float)((cell_end - cell_start) / cell_size);
+		}
+	}
+	return cells;
+}
+
+static void heapview__cell_colour(const heapview_cell *cell, unsigned char rgb[3]) {
+	float used = zloc__Min(cell->used, 1.f);
+	float boundary = cell->boundaries > 1 ? 40.f : 0.f;
+	rgb[0] = (unsigned char)zloc__Min(30.f + used * 200.f + boundary, 255.f);
+	rgb[1] = (unsigned char)zloc__Min(40.f + (1.f - used) * 60.f + boundary, 255.f);
+	rgb[2] = (unsigned char)zloc__Min(90.f + (1.f - used) * 120.f + boundary, 255.f);
+}
+
+static int heapview__write_ppm(const char *path, const heapview_dump *dump, int width) {
+	int height;
+	heapview_cell *cells = heapview__build_map(dump, width, &height);
+	FILE *file = cells ? fopen(path, "wb") : 0;
+	if (!file) {
+		printf("Unable to write %s\n", path);
+		free(cells);
+		return 0;
+	}
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	for (size_t i = 0; i != (size_t)width * (size_t)height; ++i) {
+		unsigned char rgb[3];
+		heapview__cell_colour(&cells[i], rgb);
+		fwrite(rgb, 3, 1, file);
+	}
+	fclose(file);
+	free(cells);
+	return 1;
+}
+
+static int heapview__write_html(const char *path, const char *dump_path, const heapview_dump *dump, const heapview_summary *summary, int width) {
+	int height;
+	heapview_cell *cells = heapview__build_map(dump, width, &height);
+	FILE *file = cells ? fopen(path, "w") : 0;
+	if (!file) {
+		printf("Unable to write %s\n", path);
+		free(cells);
+		return 0;
+	}
+	int scale = zloc__Max(1024 / width, 1);
+	fprintf(file, "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>zloc heap: %s</title></head>\n", dump_path);
+	fprintf(file, "<body style=\"font-family: monospace; background: #111; color: #ddd\">\n<h3>%s</h3>\n", dump_path);
+	fprintf(file, "<canvas id=\"map\" width=\"%d\" height=\"%d\" style=\"image-rendering: pixelated\"></canvas>\n", width * scale, height * scale);
+	fprintf(file, "<p>%s pool, %llu bytes, %llu bytes per cell<br>\n", (dump->header.flags & zloc_heap_dump_remote) ? "remote" : "local",
+		(unsigned long long)dump->header.pool_size, (unsigned long long)((dump->header.pool_size + (uint64_t)width * height - 1) / ((uint64_t)width * height)));
+	fprintf(file, "%llu used blocks (%llu bytes), %llu free blocks (%llu bytes), largest free block %llu bytes, external fragmentation %.3f</p>\n",
+		(unsigned long long)summary->used_blocks, (unsigned long long)summary->used_bytes, (unsigned long long)summary->free_blocks,
+		(unsigned long long)summary->free_bytes, (unsigned long long)summary->largest_free_block, summary->external_fragmentation);
+	fprintf(file, "<script>\nvar width = %d, height = %d, scale = %d;\nvar cells = [", width, height, scale);
+	for (size_t i = 0; i != (size_t)width * (size_t)height; ++i) {
+		unsigned char rgb[3];
+		heapview__cell_colour(&cells[i], rgb);
+		fprintf(file, i ? ",%u" : "%u", ((unsigned int)rgb[0] << 16) | ((unsigned int)rgb[1] << 8) | rgb[2]);
+	}
+	fprintf(file, "];\nvar context = document.getElementById('map').getContext('2d');\n");
+	fprintf(file, "for (var i = 0; i < cells.length; ++i) {\n\tcontext.fillStyle = '#' + ('00000' + cells[i].toString(16)).slice(-6);\n");
+	fprintf(file, "\tcontext.fillRect((i %% width) * scale, Math.floor(i / width) * scale, scale, scale);\n}\n</script>\n</body></html>\n");
+	fclose(file);
+	free(cells);
+	return 1;
+}
+
+/*
+	Both dumps are in offset order so the blocks can be matched up by walking them side by side. A block is unchanged
+	if the same offset has the same size and state in both.
+*/
+static void heapview__diff(const heapview_dump *a, const heapview_dump *b, int json) {
+	uint64_t i = 0, j = 0, added = 0, removed = 0, changed = 0;
+	if (json) {
+		printf("{\n\t\"changes\": [");
+	}
+	while (i < a->header.block_count || j < b->header.block_count) {
+		const zloc_heap_dump_block *before = i < a->header.block_count ? &a->blocks[i] : 0;
+		const zloc_heap_dump_block *after = j < b->header.block_count ? &b->blocks[j] : 0;
+		const char *change = 0;
+		if (before && after && before->offset == after->offset) {
+			if (before->size != after->size || before->flags != after->flags || before->tag != after->tag) {
+				change = "changed";
+				changed++;
+			}
+			i++, j++;
+		} else if (!after || (before && before->offset < after->offset)) {
+			change = "removed";
+			after = 0;
+			removed++;
+			i++;
+		} else {
+			change = "added";
+			before = 0;
+			added++;
+			j++;
+		}
+		if (!change) {
+			continue;
+		}
+		if (json) {
+			printf(added + removed + changed > 1 ? ",\n\t\t{\"change\": \"%s\"" : "\n\t\t{\"change\": \"%s\"", change);
+			if (before) {
+				printf(", \"before\": ");
+				heapview__print_block_json(before);
+			}
+			if (after) {
+				printf(", \"after\": ");
+				heapview__print_block_json(after);
+			}
+			printf("}");
+		} else {
+			const zloc_heap_dump_block *block = after ? after : before;
+			printf("%-8s offset %llu: ", change, (unsigned long long)block->offset);
+			if (before) {
+				printf("%llu bytes %s", (unsigned long long)before->size, (before->flags & zloc_heap_dump_block_used) ? "used" : "free");
+			}
+			if (before && after) {
+				printf(" -> ");
+			}
+			if (after) {
+				printf("%llu bytes %s", (unsigned long long)after->size, (after->flags & zloc_heap_dump_block_used) ? "used" : "free");
+			}
+			printf("\n");
+		}
+	}
+	heapview_summary summary_a, summary_b;
+	heapview__summarise(a, &summary_a);
+	heapview__summarise(b, &summary_b);
+	if (json) {
+		printf("\n\t],\n\t\"added\": %llu,\n\t\"removed\": %llu,\n\t\"changed\": %llu,\n", (unsigned long long)added, (unsigned long long)removed, (unsigned long long)changed);
+		printf("\t\"used_bytes_delta\": %lld,\n\t\"free_bytes_delta\": %lld,\n\t\"largest_free_block_delta\": %lld,\n\t\"external_fragmentation_delta\": %.4f\n}\n",
+			(long long)(summary_b.used_bytes - summary_a.used_bytes), (long long)(summary_b.free_bytes - summary_a.free_bytes),
+			(long long)(summary_b.largest_free_block - summary_a.largest_free_block), summary_b.external_fragmentation - summary_a.external_fragmentation);
+	} else {
+		printf("blocks:                   %llu added, %llu removed, %llu changed\n", (unsigned long long)added, (unsigned long long)removed, (unsigned long long)changed);
+		printf("used bytes:               %llu -> %llu\n", (unsigned long long)summary_a.used_bytes, (unsigned long long)summary_b.used_bytes);
+		printf("free bytes:               %llu -> %llu\n", (unsigned long long)summary_a.free_bytes, (unsigned long long)summary_b.free_bytes);
+		printf("largest free block:       %llu -> %llu\n", (unsigned long long)summary_a.largest_free_block, (unsigned long long)summary_b.largest_free_block);
+		printf("external fragmentation:   %.3f -> %.3f\n", summary_a.external_fragmentation, summary_b.external_fragmentation);
+	}
+}
+
+static int heapview__usage(const char *name) {
+	printf("Usage: %s dump_file [--json] [--html file] [--ppm file] [--width cells] [--diff other_dump_file]\n", name);
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		return heapview__usage(argv[0]);
+	}
+	const char *path = argv[1];
+	const char *html_path = 0;
+	const char *ppm_path = 0;
+	const char *diff_path = 0;
+	int json = 0;
+	int width = 256;
+	for (int i = 2; i < argc; ++i) {
+		if (strcmp(argv[i], "--json") == 0) {
+			json = 1;
+		} else if (strcmp(argv[i], "--html") == 0 && i + 1 < argc) {
+			html_path = argv[++i];
+		} else if (strcmp(argv[i], "--ppm") == 0 && i + 1 < argc) {
+			ppm_path = argv[++i];
+		} else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+			width = atoi(argv[++i]);
+			width = zloc__Max(width, 1);
+		} else if (strcmp(argv[i], "--diff") == 0 && i + 1 < argc) {
+			diff_path = argv[++i];
+		} else {
+			return heapview__usage(argv[0]);
+		}
+	}
+
+	heapview_dump dump;
+	if (!heapview__load(path, &dump)) {
+		return 1;
+	}
+	heapview_summary summary;
+	heapview__summarise(&dump, &summary);
+	int result = 0;
+	if (diff_path) {
+		heapview_dump other;
+		if (heapview__load(diff_path, &other)) {
+			heapview__diff(&dump, &other, json);
+			free(other.blocks);
+		} else {
+			result = 1;
+		}
+	} else if (json) {
+		heapview__print_json(&dump, &summary);
+	} else {
+		heapview__print_summary(path, &dump, &summary);
+	}
+	if (html_path && !heapview__write_html(html_path, path, &dump, &summary, width)) {
+		result = 1;
+	}
+	if (ppm_path && !heapview__write_ppm(ppm_path, &dump, width)) {
+		result = 1;
+	}
+	free(dump.blocks);
+	return result;
+}
@@ -0,0 +1,322 @@
+/*
+	Trace replay
+
+	Feeds a trace recorded with ZLOC_ENABLE_TRACING back into a fresh allocator and reports throughput, peak footprint
+	and fragmentation. Build it with different settings to see how they'd do against a real workload, for example:
+
+	clang -O2 replay.c -o replay.app -DZLOC_MAX_SIZE_INDEX=30
+	./replay.app game.trace --minimum-allocation-size 256
+
+	replay.app trace_file [--minimum-allocation-size bytes] [--pool-size megabytes] [--sample events]
+
+	--minimum-allocation-size	Defaults to the minimum allocation size the trace was recorded with
+	--pool-size					Size of the pool to replay into in megabytes (default 1024)
+	--sample					Measure fragmentation every n events (default 10000)
+
+	Events are replayed in the order they were recorded on a single thread. Allocations are matched up by the offset
+	they had when they were recorded, so frees and reallocations go to the right place. If the trace was recorded into
+	a ring buffer that wrapped, frees of allocations that happened before the trace started are skipped.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ZLOC_IMPLEMENTATION
+#define ZLOC_ENABLE_TRACING
+#include "zloc.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+typedef unsigned long long replay_u64;
+
+static replay_u64 replay__now(void) {
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (replay_u64)((double)counter.QuadPart * 1000000000.0 / (double)frequency.QuadPart);
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (replay_u64)now.tv_sec * 1000000000ull + (replay_u64)now.tv_nsec;
+#endif
+}
+
+/*
+	Maps the offset an allocation had when it was recorded to the allocation made for it in the replay. Open addressing
+	with linear probing, deleted slots are left as tombstones until the table grows.
+*/
+#define replay__EMPTY 0
+#define replay__TOMBSTONE 1
+
+typedef struct replay_slot {
+	uint64_t offset;
+	void *allocation;
+	uint64_t size;
+} replay_slot;
+
+typedef struct replay_map {
+	replay_slot *slots;
+	size_t capacity;
+	size_t used;		//Live entries plus tombstones
+} replay_map;
+
+static size_t replay__hash(uint64_t offset, size_t capacity) {
+	offset ^= offset >> 33;
+	offset *= 0xff51afd7ed558ccdull;
+	offset ^= offset >> 33;
+	return (size_t)offset & (capacity - 1);
+}
+
+static replay_slot *replay__find(replay_map *map, uint64_t offset) {
+	size_t index = replay__hash(offset, map->capacity);
+	while (map->slots[index].offset != replay__EMPTY) {
+		if (map->slots[index].offset == offset) {
+			return &map->slots[index];
+		}
+		index = (index + 1) & (map->capacity - 1);
+	}
+	return 0;
+}
+
+static void replay__insert(replay_map *map, uint64_t offset, void *allocation, uint64_t size);
+
+static void replay__grow(replay_map *map) {
+	replay_map old = *map;
+	map->capacity = old.capacity ? old.capacity * 2 : 1024;
+	map->slots = (replay_slot*)calloc(map->capacity, sizeof(replay_slot));
+	map->used = 0;
+	for (size_t i = 0; i != old.capacity; ++i) {
+		if (old.slots[i].offset > replay__TOMBSTONE) {
+			replay__insert(map, old.slots[i].offset, old.slots[i].allocation, old.slots[i].size);
+		}
+	}
+	free(old.slots);
+}
+
+static void replay__insert(replay_map *map, uint64_t offset, void *allocation, uint64_t size) {
+	if ((map->used + 1) * 2 > map->capacity) {
+		replay__grow(map);
+	}
+	size_t index = replay__hash(offset, map->capacity);
+	while (map->slots[index].offset > replay__TOMBSTONE) {
+		index = (index + 1) & (map->capacity - 1);
+	}
+	if (map->slots[index].offset == replay__EMPTY) {
+		map->used++;
+	}
+	map->slots[index].offset = offset;
+	map->slots[index].allocation = allocation;
+	map->slots[index].size = size;
+}
+
+typedef struct replay_results {
+	size_t events;
+	size_t failed;
+	size_t unmatched;
+	replay_u64 nanoseconds;
+	zloc_size live_bytes;
+	zloc_size peak_live_bytes;
+	zloc_size peak_used_bytes;
+	zloc_size high_water_mark;
+	double fragmentation_total;
+	double peak_fragmentation;
+	double final_fragmentation;
+	size_t fragmentation_samples;
+} replay_results;
+
+/*
+	External fragmentation of the pool: 1 - largest free block / total free memory. 0 means all of the free memory is
+	in one block, close to 1 means it's scattered in lots of small blocks.
+*/
+static double replay__fragmentation(const zloc_pool *pool) {
+	zloc_header *block = zloc__first_block_in_pool(pool);
+	zloc_size total_free = 0, largest_free = 0;
+	while (!zloc__is_last_block_in_pool(block)) {
+		if (zloc__is_free_block(block)) {
+			total_free += zloc__block_size(block);
+			largest_free = zloc__Max(largest_free, zloc__block_size(block));
+		}
+		block = zloc__next_physical_block(block);
+	}
+	return total_free ? 1.0 - (double)largest_free / (double)total_free : 0.0;
+}
+
+static void replay__track_footprint(replay_results *results, zloc_allocator *allocator, void *pool, void *allocation) {
+	zloc_size used = allocator->stats.capacity - allocator->stats.free;
+	results->peak_used_bytes = zloc__Max(results->peak_used_bytes, used);
+	results->peak_live_bytes = zloc__Max(results->peak_live_bytes, results->live_bytes);
+	if (allocation) {
+		zloc_header *block = zloc__block_from_allocation(allocation);
+		zloc_size end = (zloc_size)((char*)zloc__next_physical_block(block) - (char*)pool);
+		results->high_water_mark = zloc__Max(results->high_water_mark, end);
+	}
+}
+
+static void replay__sample(replay_results *results, const zloc_pool *pool) {
+	double fragmentation = replay__fragmentation(pool);
+	results->fragmentation_total += fragmentation;
+	results->peak_fragmentation = zloc__Max(results->peak_fragmentation, fragmentation);
+	results->fragmentation_samples++;
+}
+
+static void replay__run(zloc_allocator *allocator, const zloc_trace_event *events, size_t count, size_t sample_interval, replay_results *results) {
+	replay_map map = { 0 };
+	replay__grow(&map);
+	void *pool = zloc_GetPool(allocator);
+	for (size_t i = 0; i != count; ++i) {
+		const zloc_trace_event *event = &events[i];
+		void *allocation = 0;
+		replay_slot *slot = 0;
+		replay_u64 start = 0;
+		switch (event->op) {
+		case zloc_trace_op_allocate:
+		case zloc_trace_op_allocate_aligned:
+			//Calls that failed when they were recorded are skipped, there'd be nothing to free them later
+			if (!event->offset) {
+				continue;
+			}
+			start = replay__now();
+			allocation = event->op == zloc_trace_op_allocate ? zloc_Allocate(allocator, event->size) : zloc_AllocateAligned(allocator, event->size, (zloc_size)1 << event->alignment_log2);
+			results->nanoseconds += replay__now() - start;
+			if (!allocation) {
+				results->failed++;
+				continue;
+			}
+			replay__insert(&map, event->offset, allocation, event->size);
+			results->live_bytes += event->size;
+			break;
+		case zloc_trace_op_free:
+			slot = replay__find(&map, event->previous_offset);
+			if (!slot) {
+				results->unmatched++;
+				continue;
+			}
+			start = replay__now();
+			zloc_Free(allocator, slot->allocation);
+			results->nanoseconds += replay__now() - start;
+			results->live_bytes -= slot->size;
+			slot->offset = replay__TOMBSTONE;
+			break;
+		case zloc_trace_op_reallocate:
+			if (!event->offset) {
+				continue;
+			}
+			slot = replay__find(&map, event->previous_offset);
+			if (!slot) {
+				results->unmatched++;
+			}
+			start = replay__now();
+			allocation = zloc_Reallocate(allocator, slot ? slot->allocation : 0, event->size);
+			results->nanoseconds += replay__now() - start;
+			if (!allocation) {
+				results->failed++;
+				continue;
+			}
+			if (slot) {
+				results->live_bytes -= slot->size;
+				slot->offset = replay__TOMBSTONE;
+			}
+			replay__insert(&map, event->offset, allocation, event->size);
+			results->live_bytes += event->size;
+			break;
+		default:
+			continue;
+		}
+		results->events++;
+		replay__track_footprint(results, allocator, pool, allocation);
+		if (sample_interval && results->events % sample_interval == 0) {
+			replay__sample(results, pool);
+		}
+	}
+	results->final_fragmentation = replay__fragmentation(pool);
+	free(map.slots);
+}
+
+static int replay__usage(const char *name) {
+	printf("Usage: %s trace_file [--minimum-allocation-size bytes] [--pool-size megabytes] [--sample events]\n", name);
+	return 1;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		return replay__usage(argv[0]);
+	}
+	const char *path = argv[1];
+	zloc_size minimum_allocation_size = 0;
+	zloc_size pool_size = zloc__MEGABYTE(1024);
+	size_t sample_interval = 10000;
+	for (int i = 2; i < argc; ++i) {
+		if (strcmp(argv[i], "--minimum-allocation-size") == 0 && i + 1 < argc) {
+			minimum_allocation_size = (zloc_size)strtoull(argv[++i], 0, 10);
+		} else if (strcmp(argv[i], "--pool-size") == 0 && i + 1 < argc) {
+			pool_size = (zloc_size)zloc__MEGABYTE(strtoull(argv[++i], 0, 10));
+		} else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc) {
+			sample_interval = (size_t)strtoull(argv[++i], 0, 10);
+		} else {
+			return replay__usage(argv[0]);
+		}
+	}
+
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		printf("Unable to open %s\n", path);
+		return 1;
+	}
+	zloc_trace_file_header header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, ZLOC_TRACE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+		printf("%s is not a zloc trace file\n", path);
+		fclose(file);
+		return 1;
+	}
+	if (header.version != ZLOC_TRACE_FILE_VERSION || header.event_size != sizeof(zloc_trace_event)) {
+		printf("%s was written by an incompatible version (version %u, event size %u)\n", path, header.version, header.event_size);
+		fclose(file);
+		return 1;
+	}
+	fseek(file, 0, SEEK_END);
+	long file_size = ftell(file);
+	fseek(file, sizeof(header), SEEK_SET);
+	size_t count = (size_t)(file_size - (long)sizeof(header)) / sizeof(zloc_trace_event);
+	zloc_trace_event *events = (zloc_trace_event*)malloc(count * sizeof(zloc_trace_event) + 1);
+	count = fread(events, sizeof(zloc_trace_event), count, file);
+	fclose(file);
+
+	if (!minimum_allocation_size) {
+		minimum_allocation_size = (zloc_size)header.minimum_allocation_size;
+	}
+	void *memory = malloc(pool_size);
+	zloc_allocator *allocator = memory ? zloc_InitialiseAllocatorWithPool(memory, pool_size) : 0;
+	if (!allocator) {
+		printf("Unable to create a %zuMB pool to replay into\n", (size_t)(pool_size / zloc__MEGABYTE(1)));
+		free(events);
+		free(memory);
+		return 1;
+	}
+	if (minimum_allocation_size > zloc__MINIMUM_BLOCK_SIZE) {
+		zloc_SetMinimumAllocationSize(allocator, minimum_allocation_size);
+	}
+
+	replay_results results;
+	memset(&results, 0, sizeof(results));
+	replay__run(allocator, events, count, sample_interval, &results);
+
+	printf("trace:                    %s (%zu events, recorded with ZLOC_MAX_SIZE_INDEX %u, minimum allocation size %llu)\n",
+		path, count, header.max_size_index, (unsigned long long)header.minimum_allocation_size);
+	printf("replayed with:            ZLOC_MAX_SIZE_INDEX %u, minimum allocation size %zu, %zuMB pool\n",
+		(unsigned int)ZLOC_MAX_SIZE_INDEX, allocator->minimum_allocation_size, (size_t)(pool_size / zloc__MEGABYTE(1)));
+	printf("operations replayed:      %zu (%zu failed, %zu unmatched)\n", results.events, results.failed, results.unmatched);
+	printf("throughput:               %.0f ops/sec\n", results.nanoseconds ? (double)results.events * 1000000000.0 / (double)results.nanoseconds : 0.0);
+	printf("peak live bytes:          %zu (requested sizes)\n", results.peak_live_bytes);
+	printf("peak used bytes:          %zu (block sizes)\n", results.peak_used_bytes);
+	printf("peak footprint:           %zu (highest address used in the pool)\n", results.high_water_mark);
+	printf("fragmentation:            mean %.3f, peak %.3f, final %.3f\n",
+		results.fragmentation_samples ? results.fragmentation_total / (double)results.fragmentation_samples : 0.0, results.peak_fragmentation, results.final_fragmentation);
+
+	free(events);
+	free(memory);
+	return 0;
+}
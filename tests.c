@@ -12,6 +12,22 @@
 #define ZLOC_MAX_SIZE_INDEX 35		//max block size 34GB
 #define ZLOC_EXTRA_DEBUGGING
 #define ZLOC_SAFEGUARDS
+#define ZLOC_ENABLE_TRACING
+#define ZLOC_ENABLE_CLASS_STATS
+#define ZLOC_ENABLE_TAGGING
+#define ZLOC_ENABLE_SAMPLING
+#define ZLOC_ENABLE_GUARD_PAGES
+#define ZLOC_ENABLE_QUARANTINE
+#define ZLOC_ENABLE_MEMORY_POISONING
+#define ZLOC_ENABLE_HEADER_CHECKSUMS
+#define ZLOC_ENABLE_NUMA
+#define ZLOC_ENABLE_ZERO_TRACKING
+//Pretend to be on whichever node the NUMA tests want so that they work the same on any machine
+static unsigned int test_numa_node = 0;
+#define ZLOC_NUMA_CURRENT_NODE() test_numa_node
+//Count corrupt headers instead of asserting so that it can be tested
+static int corrupt_headers_found = 0;
+#define ZLOC_HEADER_CORRUPTED(block) corrupt_headers_found++
 
 //#include "minimal/zloc_min.h"
 #include "zloc.h"
@@ -29,6 +45,8 @@ typedef void *(*zloc__allocation_thread)(void*);
 typedef void *( *zloc__allocation_thread)(void*);
 #endif
 #include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
 #define zloc_sleep(seconds) sleep(seconds)
 #endif
 
@@ -80,7 +98,7 @@ unsigned long long _zloc_random_range(zloc_random *random, unsigned long long ma
 	fflush(stdout); \
 } while (0)
 
-static void zloc__output(void* ptr, size_t size, int free, void* user, int is_final_output)
+static zloc__no_sanitize void zloc__output(void* ptr, size_t size, int free, void* user, int is_final_output)
 {
 	(void)user;
 	zloc_header *block = (zloc_header*)ptr;
@@ -92,7 +110,7 @@ static void zloc__output(void* ptr, size_t size, int free, void* user, int is_fi
 
 //Some helper functions for debugging
 //Makes sure that all blocks in the segregated list of free blocks are all valid
-zloc__error_codes zloc_VerifySegregatedLists(zloc_allocator *allocator) {
+zloc__no_sanitize zloc__error_codes zloc_VerifySegregatedLists(zloc_allocator *allocator) {
 	for (int fli = 0; fli != zloc__FIRST_LEVEL_INDEX_COUNT; ++fli) {
 		for (int sli = 0; sli != zloc__SECOND_LEVEL_INDEX_COUNT; ++sli) {
 			zloc_header *block = allocator->segregated_lists[fli][sli];
@@ -128,7 +146,7 @@ zloc_bool zloc_BlockExistsInSegregatedList(zloc_allocator *allocator, zloc_heade
 }
 
 //Loops through all blocks in the allocator and confirms that they all correctly link together
-zloc__error_codes zloc_VerifyBlocks(zloc_header *first_block, zloc__block_output output_function, void *user_data) {
+zloc__no_sanitize zloc__error_codes zloc_VerifyBlocks(zloc_header *first_block, zloc__block_output output_function, void *user_data) {
 	zloc_header *current_block = first_block;
 	while (!zloc__is_last_block_in_pool(current_block)) {
 		if (output_function) {
@@ -146,7 +164,7 @@ zloc__error_codes zloc_VerifyBlocks(zloc_header *first_block, zloc__block_output
 	return zloc__OK;
 }
 
-zloc__error_codes zloc_VerifyRemoteBlocks(zloc_header *first_block, zloc__block_output output_function, void *user_data) {
+zloc__no_sanitize zloc__error_codes zloc_VerifyRemoteBlocks(zloc_header *first_block, zloc__block_output output_function, void *user_data) {
 	zloc_header *current_block = first_block;
 	int count = 0;
 	while (!zloc__is_last_block_in_pool(current_block)) {
@@ -413,51 +431,1618 @@ int TestReAllocationFallbackToAllocateAndCopy(void) {
 	return result;
 }
 
+//When the next block is used but the previous block is free the reallocation should grow backwards into it
+int TestReAllocationGrowBackwards(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	if (!allocator) {
+		result = 0;
+	}
+	else {
+		char *allocation1 = zloc_Allocate(allocator, 1024);
+		char *allocation2 = zloc_Allocate(allocator, 1024);
+		char *allocation3 = zloc_Allocate(allocator, 1024);
+		for (int i = 0; i != 1024; ++i) {
+			allocation2[i] = (char)i;
+		}
+		zloc_Free(allocator, allocation1);
+		int free_blocks = allocator->stats.free_blocks;
+		char *grown = zloc_Reallocate(allocator, allocation2, 1800);
+		if (grown != allocation1 || zloc_UsableSize(grown) < 1800) {
+			result = 0;
+		}
+		for (int i = 0; i != 1024; ++i) {
+			if (grown[i] != (char)i) {
+				result = 0;
+				break;
+			}
+		}
+		//The spare room at the end is split off and sits between the grown block and the third allocation
+		zloc_header *trimmed = zloc__next_physical_block(zloc__block_from_allocation(grown));
+		if (!zloc__is_free_block(trimmed) || zloc__next_physical_block(trimmed) != zloc__block_from_allocation(allocation3)) {
+			result = 0;
+		}
+		if (allocator->stats.free_blocks != free_blocks) {
+			result = 0;
+		}
+		zloc_VerifyPool(allocator, zloc_GetPool(allocator));
+		zloc_Free(allocator, grown);
+		zloc_Free(allocator, allocation3);
+		zloc_VerifyPool(allocator, zloc_GetPool(allocator));
+		if (allocator->stats.free_blocks != 1 || allocator->stats.free != allocator->stats.capacity) {
+			result = 0;
+		}
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+//Both neighbours are free but neither is big enough on its own so the block should absorb both of them
+int TestReAllocationGrowBackwardsAndForwards(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	if (!allocator) {
+		result = 0;
+	}
+	else {
+		char *allocation1 = zloc_Allocate(allocator, 1024);
+		char *allocation2 = zloc_Allocate(allocator, 1024);
+		char *allocation3 = zloc_Allocate(allocator, 1024);
+		char *allocation4 = zloc_Allocate(allocator, 1024);
+		memset(allocation2, 3, 1024);
+		zloc_Free(allocator, allocation1);
+		zloc_Free(allocator, allocation3);
+		char *grown = zloc_Reallocate(allocator, allocation2, 2800);
+		if (grown != allocation1 || zloc_UsableSize(grown) < 2800) {
+			result = 0;
+		}
+		for (int i = 0; i != 1024; ++i) {
+			if (grown[i] != 3) {
+				result = 0;
+				break;
+			}
+		}
+		memset(grown, 5, 2800);
+		zloc_VerifyPool(allocator, zloc_GetPool(allocator));
+		zloc_Free(allocator, grown);
+		zloc_Free(allocator, allocation4);
+		zloc_VerifyPool(allocator, zloc_GetPool(allocator));
+		if (allocator->stats.free_blocks != 1) {
+			result = 0;
+		}
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+//The tail of a shrunk block must merge with a free block that follows it, not sit next to it
+int TestShrinkNextToFreeBlock(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	if (!allocator) {
+		result = 0;
+	}
+	else {
+		char *allocation1 = zloc_Allocate(allocator, 4096);
+		char *allocation2 = zloc_Allocate(allocator, 1024);
+		char *allocation3 = zloc_Allocate(allocator, 1024);
+		memset(allocation1, 9, 4096);
+		zloc_Free(allocator, allocation2);
+		int free_blocks = allocator->stats.free_blocks;
+		zloc_size free_memory = allocator->stats.free;
+		char *shrunk = zloc_Shrink(allocator, allocation1, 1000);
+		if (shrunk != allocation1 || zloc_UsableSize(shrunk) < 1000 || zloc_UsableSize(shrunk) >= 4096) {
+			result = 0;
+		}
+		for (int i = 0; i != 1000; ++i) {
+			if (shrunk[i] != 9) {
+				result = 0;
+				break;
+			}
+		}
+		zloc_header *tail = zloc__next_physical_block(zloc__block_from_allocation(shrunk));
+		if (!zloc__is_free_block(tail) || zloc__next_physical_block(tail) != zloc__block_from_allocation(allocation3)) {
+			result = 0;
+		}
+		if (allocator->stats.free_blocks != free_blocks || allocator->stats.free <= free_memory) {
+			result = 0;
+		}
+		zloc_VerifyPool(allocator, zloc_GetPool(allocator));
+		//Growing through shrink does nothing
+		if (zloc_Shrink(allocator, shrunk, 8192) != shrunk || zloc_UsableSize(shrunk) >= 4096) {
+			result = 0;
+		}
+		//Reallocating to a smaller size takes the same path
+		char *allocation4 = zloc_Allocate(allocator, 4096);
+		zloc_Free(allocator, allocation3);
+		char *reallocated = zloc_Reallocate(allocator, shrunk, 256);
+		if (reallocated != shrunk) {
+			result = 0;
+		}
+		zloc_VerifyPool(allocator, zloc_GetPool(allocator));
+		zloc_Free(allocator, reallocated);
+		zloc_Free(allocator, allocation4);
+		zloc_VerifyPool(allocator, zloc_GetPool(allocator));
+		if (allocator->stats.free_blocks != 1 || allocator->stats.free != allocator->stats.capacity) {
+			result = 0;
+		}
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
 int TestReAllocationOfNullPtr(void) {
 	zloc_size size = zloc__MEGABYTE(16);
 	int result = 1;
-	void *memory = malloc(size);
-	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
-	assert(zloc_VerifySegregatedLists(allocator) == zloc__OK);
-	if (!allocator) {
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	assert(zloc_VerifySegregatedLists(allocator) == zloc__OK);
+	if (!allocator) {
+		result = 0;
+	}
+	else {
+		void *allocation = 0;
+		allocation = zloc_Reallocate(allocator, allocation, 1024);
+		if (!allocation) {
+			result = 0;
+		}
+		else {
+			result = 1;
+		}
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestAlignedAllocation(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	if (!allocator) {
+		result = 0;
+	}
+	else {
+		void *allocation = 0;
+		allocation = zloc_AllocateAligned(allocator, 1024, 64);
+		if (!allocation) {
+			result = 0;
+		}
+		else {
+			result = 1;
+		}
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestUsableSize(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	if (!allocator) {
+		result = 0;
+	}
+	else {
+		zloc_size usable_size = 0;
+		void *allocation = zloc_AllocateSizeReturning(allocator, 13, &usable_size);
+		if (!allocation || usable_size < 13 || usable_size != zloc_UsableSize(allocation)) {
+			result = 0;
+		}
+		else {
+			//All of the usable size must be writable without trampling the next block
+			memset(allocation, 7, usable_size);
+			zloc_VerifyPool(allocator, zloc_GetPool(allocator));
+		}
+		if (zloc_UsableSize(0) != 0) {
+			result = 0;
+		}
+		zloc_Free(allocator, allocation);
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+//When a free block is too small to be worth splitting the whole block is handed out and the slack should be reported
+int TestUsableSizeOfUnsplitBlock(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	if (!allocator) {
+		result = 0;
+	}
+	else {
+		void *allocation1 = zloc_Allocate(allocator, 1024);
+		void *allocation2 = zloc_Allocate(allocator, 64);
+		zloc_Free(allocator, allocation1);
+		zloc_size usable_size = 0;
+		void *allocation3 = zloc_AllocateSizeReturning(allocator, 1000, &usable_size);
+		if (allocation3 != allocation1 || usable_size != 1024) {
+			result = 0;
+		}
+		memset(allocation3, 7, usable_size);
+		zloc_VerifyPool(allocator, zloc_GetPool(allocator));
+		zloc_Free(allocator, allocation2);
+		zloc_Free(allocator, allocation3);
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestFragmentationReport(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_fragmentation_report report;
+	zloc_GetFragmentationReport(allocator, &report);
+	//One big free block to start with
+	if (report.total_free != allocator->stats.free || report.largest_free_block != report.total_free || report.external_fragmentation != 0.f || report.free_blocks != 1) {
+		result = 0;
+	}
+	//Free every other allocation to leave lots of small holes
+	void *allocations[200];
+	for (int i = 0; i != 200; ++i) {
+		allocations[i] = zloc_Allocate(allocator, 1000 + i * 16);
+	}
+	for (int i = 0; i < 200; i += 2) {
+		zloc_Free(allocator, allocations[i]);
+	}
+	zloc_GetFragmentationReport(allocator, &report);
+	zloc_pool_stats_t snapshot = zloc_CreateMemorySnapshot(zloc_GetPool(allocator));
+	zloc_size largest = 0;
+	for (zloc_header *block = zloc__first_block_in_pool(zloc_GetPool(allocator)); !zloc__is_last_block_in_pool(block); block = zloc__next_physical_block(block)) {
+		if (zloc__is_free_block(block)) {
+			largest = zloc__Max(largest, zloc__block_size(block));
+		}
+	}
+	zloc_size by_class = 0;
+	for (int fli = 0; fli != zloc__FIRST_LEVEL_INDEX_COUNT; ++fli) {
+		for (int sli = 0; sli != zloc__SECOND_LEVEL_INDEX_COUNT; ++sli) {
+			by_class += report.free_bytes_by_class[fli][sli];
+		}
+	}
+	if (report.total_free != snapshot.free_size || by_class != snapshot.free_size || report.largest_free_block != largest || report.free_blocks != snapshot.free_blocks) {
+		result = 0;
+	}
+	if (report.external_fragmentation <= 0.f || report.external_fragmentation >= 1.f) {
+		result = 0;
+	}
+	//Freeing the rest brings it back to a single block
+	for (int i = 1; i < 200; i += 2) {
+		zloc_Free(allocator, allocations[i]);
+	}
+	zloc_GetFragmentationReport(allocator, &report);
+	if (report.external_fragmentation != 0.f || report.total_free != allocator->stats.capacity) {
+		result = 0;
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestHeapDump(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	void *allocations[10];
+	for (int i = 0; i != 10; ++i) {
+		allocations[i] = zloc_Allocate(allocator, 256 * (i + 1));
+	}
+	for (int i = 0; i < 10; i += 3) {
+		zloc_Free(allocator, allocations[i]);
+	}
+	FILE *file = tmpfile();
+	if (!file || !zloc_WriteHeapDump(allocator, zloc_GetPool(allocator), file)) {
+		result = 0;
+	}
+	else {
+		rewind(file);
+		zloc_heap_dump_header header;
+		if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, ZLOC_HEAP_DUMP_MAGIC, 8) || header.flags != 0 || header.block_overhead != zloc__BLOCK_POINTER_OFFSET) {
+			result = 0;
+		}
+		//Every block in the pool should be there in physical order with matching offsets, sizes and state
+		zloc_header *block = zloc__first_block_in_pool(zloc_GetPool(allocator));
+		zloc_heap_dump_block record;
+		zloc_size used_count = 0;
+		for (zloc_size i = 0; result && i != header.block_count; ++i) {
+			if (fread(&record, sizeof(record), 1, file) != 1 || zloc__is_last_block_in_pool(block) ||
+				(char*)zloc_GetPool(allocator) + record.offset != (char*)zloc__block_user_ptr(block) || record.size != zloc__block_size(block) ||
+				(record.flags & zloc_heap_dump_block_used) == zloc__is_free_block(block)) {
+				result = 0;
+			}
+			used_count += (record.flags & zloc_heap_dump_block_used) ? 1 : 0;
+			block = zloc__next_physical_block(block);
+		}
+		if (!zloc__is_last_block_in_pool(block) || used_count != 6 || fread(&record, 1, 1, file) != 0) {
+			result = 0;
+		}
+		fclose(file);
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+zloc_size leak_callback_count = 0;
+void on_leak(void *user_data, void *allocation, zloc_size size, zloc_uint tag) {
+	if (zloc_UsableSize(allocation) == size && zloc_GetAllocationTag(allocation) == tag) {
+		leak_callback_count++;
+	}
+}
+
+int TestLeakReport(void) {
+	int result = 1;
+	zloc_size size = zloc_AllocatorSize() + zloc__KILOBYTE(64);
+	void *memory = malloc(size);
+	void *extra_memory = malloc(zloc__MEGABYTE(1));
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	void *allocations[35];
+	for (int i = 0; i != 10; ++i) {
+		allocations[i] = zloc_AllocateTagged(allocator, 1000, 1);
+	}
+	for (int i = 10; i != 15; ++i) {
+		allocations[i] = zloc_AllocateTagged(allocator, 3000, 2);
+	}
+	//These won't fit in the first pool so they go in the second
+	zloc_pool *pools[2] = { zloc_GetPool(allocator), zloc_AddPool(allocator, extra_memory, zloc__MEGABYTE(1)) };
+	for (int i = 15; i != 35; ++i) {
+		allocations[i] = zloc_Allocate(allocator, 40000);
+	}
+	zloc_Free(allocator, allocations[0]);
+	zloc_Free(allocator, allocations[20]);
+	zloc_leak_group groups[8];
+	zloc_leak_report report = { 0 };
+	report.groups = groups;
+	report.max_groups = 8;
+	report.callback = on_leak;
+	zloc_CreateLeakReport(allocator, pools, 2, &report);
+	zloc_size used = zloc_CreateMemorySnapshot(pools[0]).used_size + zloc_CreateMemorySnapshot(pools[1]).used_size;
+	if (report.allocations != 33 || report.bytes != used || report.ungrouped_allocations || leak_callback_count != 33 || report.group_count != 3) {
+		result = 0;
+	}
+	if (groups[0].tag != 0 || groups[0].count != 19 || groups[1].tag != 2 || groups[1].count != 5 || groups[2].tag != 1 || groups[2].count != 9 ||
+		groups[0].total_bytes != groups[0].block_size * 19) {
+		result = 0;
+	}
+	//With room for only one group the rest are still counted
+	report.max_groups = 1;
+	report.callback = 0;
+	zloc_CreateLeakReport(allocator, pools, 2, &report);
+	if (report.group_count != 1 || report.allocations != 33 || report.ungrouped_allocations + groups[0].count != 33 || report.ungrouped_bytes + groups[0].total_bytes != used) {
+		result = 0;
+	}
+	zloc_free_memory(memory);
+	zloc_free_memory(extra_memory);
+	return result;
+}
+
+int TestTaggedAllocationsCountLiveBytes(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	void *untagged = zloc_Allocate(allocator, 100);
+	void *audio = zloc_AllocateTagged(allocator, 1000, 1);
+	void *physics = zloc_AllocateTagged(allocator, 2000, 2);
+	void *blocker = zloc_AllocateTagged(allocator, 100, 2);
+	if (zloc_GetAllocationTag(untagged) != 0 || zloc_GetAllocationTag(audio) != 1 || zloc_GetAllocationTag(physics) != 2) {
+		result = 0;
+	}
+	if (zloc_GetTagLiveBytes(allocator, 0) != zloc_UsableSize(untagged) || zloc_GetTagLiveBytes(allocator, 1) != zloc_UsableSize(audio) ||
+		zloc_GetTagLiveBytes(allocator, 2) != zloc_UsableSize(physics) + zloc_UsableSize(blocker)) {
+		result = 0;
+	}
+	//Growing the audio allocation has to move it past the blocker, it should keep its tag
+	audio = zloc_Reallocate(allocator, audio, 5000);
+	if (!audio || zloc_GetAllocationTag(audio) != 1 || zloc_GetTagLiveBytes(allocator, 1) != zloc_UsableSize(audio)) {
+		result = 0;
+	}
+	//Growing backwards into the free space the audio allocation left behind should keep the tag too
+	zloc_Free(allocator, untagged);
+	physics = zloc_Reallocate(allocator, physics, 2500);
+	if (!physics || zloc_GetAllocationTag(physics) != 2 || zloc_GetTagLiveBytes(allocator, 2) != zloc_UsableSize(physics) + zloc_UsableSize(blocker)) {
+		result = 0;
+	}
+	zloc_Free(allocator, audio);
+	zloc_Free(allocator, physics);
+	zloc_Free(allocator, blocker);
+	if (zloc_GetTagLiveBytes(allocator, 0) || zloc_GetTagLiveBytes(allocator, 1) || zloc_GetTagLiveBytes(allocator, 2)) {
+		result = 0;
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+zloc_size over_budget_calls = 0;
+zloc_bool on_over_budget(void *user_data, zloc_uint tag, zloc_size live_bytes, zloc_size size) {
+	over_budget_calls++;
+	return *(zloc_bool*)user_data;
+}
+
+int TestTagBudgets(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_SetTagBudget(allocator, 3, 4096);
+	void *allocations[8];
+	int allocated = 0;
+	for (int i = 0; i != 8; ++i) {
+		allocations[i] = zloc_AllocateTagged(allocator, 1000, 3);
+		allocated += allocations[i] ? 1 : 0;
+	}
+	//Only 4 fit within the budget and other tags can still allocate
+	void *other = zloc_AllocateTagged(allocator, 8000, 4);
+	if (allocated != 4 || zloc_GetTagLiveBytes(allocator, 3) > 4096 || !other) {
+		result = 0;
+	}
+	//Growing past the budget fails and leaves the allocation where it was
+	void *grown = zloc_Reallocate(allocator, allocations[0], 2000);
+	if (grown || zloc_UsableSize(allocations[0]) != 1000 || zloc_GetTagLiveBytes(allocator, 3) != 4000) {
+		result = 0;
+	}
+	//The callback can let an allocation through anyway
+	zloc_bool allow = 1;
+	zloc_SetTagOverBudgetCallback(allocator, on_over_budget, &allow);
+	allocations[4] = zloc_AllocateTagged(allocator, 1000, 3);
+	allow = 0;
+	allocations[5] = zloc_AllocateTagged(allocator, 1000, 3);
+	if (!allocations[4] || allocations[5] || over_budget_calls != 2) {
+		result = 0;
+	}
+	for (int i = 0; i != 5; ++i) {
+		zloc_Free(allocator, allocations[i]);
+	}
+	zloc_Free(allocator, other);
+	if (zloc_GetTagLiveBytes(allocator, 3) || zloc_GetTagLiveBytes(allocator, 4)) {
+		result = 0;
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestTagBudgetsChargeTheWholeBlock(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	//Leave a free 1008 byte block that a 1000 byte allocation will be given whole
+	void *freed = zloc_Allocate(allocator, 1008);
+	void *pin = zloc_Allocate(allocator, 100);
+	zloc_Free(allocator, freed);
+	zloc_SetTagBudget(allocator, 5, 1000);
+	void *allocation = zloc_AllocateTagged(allocator, 1000, 5);
+	if (allocation || zloc_GetTagLiveBytes(allocator, 5)) {
+		result = 0;
+	}
+	//The block has to have gone back in the free lists
+	void *reused = zloc_Allocate(allocator, 1008);
+	if (reused != freed || zloc_VerifyBlocks(zloc__allocator_first_block(allocator), 0, 0) != zloc__OK) {
+		result = 0;
+	}
+	//Out of range tags fail rather then write past the end of the tag arrays
+	if (zloc_AllocateTagged(allocator, 100, ZLOC_MAX_TAGS) || zloc_GetTagLiveBytes(allocator, ZLOC_MAX_TAGS)) {
+		result = 0;
+	}
+	zloc_Free(allocator, reused);
+	zloc_Free(allocator, pin);
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestSamplerGroupsByCallsite(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_sampler *sampler = malloc(sizeof(zloc_sampler));
+	//A 1 byte sample rate samples every allocation
+	zloc_InitialiseSampler(sampler, 1);
+	zloc_SetSampler(allocator, sampler);
+	void *allocations[100];
+	for (int i = 0; i != 50; ++i) {
+		allocations[i] = zloc_Allocate(allocator, 64);
+	}
+	for (int i = 50; i != 100; ++i) {
+		allocations[i] = zloc_Allocate(allocator, 128);
+	}
+	zloc_sample_callsite callsites[8];
+	zloc_size count = zloc_GetSampledCallsites(sampler, callsites, 8);
+	zloc_size samples = 0;
+	for (zloc_size i = 0; i != count; ++i) {
+		samples += callsites[i].samples;
+		if (i && callsites[i].estimated_bytes > callsites[i - 1].estimated_bytes) {
+			result = 0;
+		}
+	}
+	if (sampler->samples != 100 || samples != 100 || sampler->dropped || count < 2) {
+		result = 0;
+	}
+	//The second loop allocates twice as much so it should come out on top
+	if (callsites[0].sampled_bytes != 50 * 128 || callsites[0].estimated_bytes != 50 * 128) {
+		result = 0;
+	}
+	FILE *file = tmpfile();
+	if (!file || !zloc_WriteFoldedStacks(sampler, file)) {
+		result = 0;
+	} else {
+		rewind(file);
+		char line[4096];
+		int lines = 0;
+		while (fgets(line, sizeof(line), file)) {
+			const char *count_text = strrchr(line, ' ');
+			lines++;
+			if (!count_text || strtoull(count_text + 1, 0, 10) == 0) {
+				result = 0;
+			}
+		}
+		if (lines != (int)count) {
+			result = 0;
+		}
+		fclose(file);
+	}
+	zloc_SetSampler(allocator, 0);
+	for (int i = 0; i != 100; ++i) {
+		zloc_Free(allocator, allocations[i]);
+	}
+	free(sampler);
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestSamplerEstimatesBytesAllocated(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_sampler *sampler = malloc(sizeof(zloc_sampler));
+	zloc_InitialiseSampler(sampler, 4096);
+	zloc_SetSampler(allocator, sampler);
+	for (int i = 0; i != 4000; ++i) {
+		zloc_Free(allocator, zloc_Allocate(allocator, 64));
+	}
+	//256KB allocated in total, about 1 in every 64 allocations should have been sampled
+	zloc_sample_callsite callsite;
+	zloc_size count = zloc_GetSampledCallsites(sampler, &callsite, 1);
+	if (count != 1 || sampler->samples < 30 || sampler->samples > 100 || callsite.estimated_bytes < 4000 * 64 / 2 || callsite.estimated_bytes > 4000 * 64 * 2) {
+		result = 0;
+	}
+	zloc_ResetSampler(sampler);
+	if (sampler->samples || sampler->callsite_count || zloc_GetSampledCallsites(sampler, &callsite, 1)) {
+		result = 0;
+	}
+	free(sampler);
+	zloc_free_memory(memory);
+	return result;
+}
+
+#ifndef _WIN32
+int TestGuardPagesCatchOverruns(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_size page_size = (zloc_size)sysconf(_SC_PAGESIZE);
+	char *allocation = (char*)zloc_AllocateGuarded(allocator, 100, 0);
+	//The allocation should finish right before the start of a page
+	if (!allocation || zloc__align_size_up((zloc_size)(uintptr_t)(allocation + 100), page_size) - (zloc_size)(uintptr_t)(allocation + 100) >= zloc__MEMORY_ALIGNMENT) {
+		result = 0;
+	}
+	memset(allocation, 1, 100);
+	pid_t pid = fork();
+	if (pid == 0) {
+		//Make sure it's the default handler (and not a sanitizer's) that deals with the fault
+		signal(SIGSEGV, SIG_DFL);
+		signal(SIGBUS, SIG_DFL);
+		volatile char *end = allocation + zloc__align_size_up(100, zloc__MEMORY_ALIGNMENT);
+		*end = 1;
+		_exit(0);
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+	if (!WIFSIGNALED(status) || (WTERMSIG(status) != SIGSEGV && WTERMSIG(status) != SIGBUS)) {
+		result = 0;
+	}
+	if (!zloc_FreeGuarded(allocator, allocation) || zloc_VerifyBlocks(zloc__allocator_first_block(allocator), 0, 0) != zloc__OK) {
+		result = 0;
+	}
+	//Once freed the memory has to be usable again
+	void *plain = zloc_Allocate(allocator, zloc__MEGABYTE(1) / 2);
+	memset(plain, 1, zloc__MEGABYTE(1) / 2);
+	zloc_Free(allocator, plain);
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestGuardPagesMode(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_SetGuardPages(allocator, 1);
+	char *allocations[20];
+	for (int i = 0; i != 20; ++i) {
+		allocations[i] = (char*)zloc_Allocate(allocator, 32 + i * 100);
+		if (!allocations[i]) {
+			result = 0;
+			break;
+		}
+		memset(allocations[i], i, 32 + i * 100);
+	}
+	char *aligned = (char*)zloc_AllocateAligned(allocator, 64, 256);
+	if (!aligned || (uintptr_t)aligned % 256) {
+		result = 0;
+	}
+	zloc_size usable_size = 0;
+	char *sized = (char*)zloc_AllocateSizeReturning(allocator, 100, &usable_size);
+	char *tagged = (char*)zloc_AllocateTagged(allocator, 100, 3);
+	if (!sized || !tagged || usable_size != 100 || ((zloc__guard_info*)sized - 1)->magic != zloc__GUARD_MAGIC || ((zloc__guard_info*)tagged - 1)->magic != zloc__GUARD_MAGIC) {
+		result = 0;
+	}
+	//The tag has to stay with the allocation when it's moved
+	tagged = (char*)zloc_Reallocate(allocator, tagged, 200);
+	if (!tagged || !zloc_GetTagLiveBytes(allocator, 3)) {
+		result = 0;
+	}
+	zloc_Free(allocator, sized);
+	zloc_Free(allocator, tagged);
+	if (zloc_GetTagLiveBytes(allocator, 3)) {
+		result = 0;
+	}
+	char *moved = (char*)zloc_Reallocate(allocator, allocations[0], 1000);
+	if (!moved || moved == allocations[0] || moved[31] != 0) {
+		result = 0;
+	}
+	allocations[0] = moved;
+	for (int i = 0; i != 20; ++i) {
+		zloc_Free(allocator, allocations[i]);
+	}
+	zloc_Free(allocator, aligned);
+	if (zloc_VerifyBlocks(zloc__allocator_first_block(allocator), 0, 0) != zloc__OK) {
+		result = 0;
+	}
+	//With everything freed the whole pool should be one free block again
+	zloc_SetGuardPages(allocator, 0);
+	void *everything = zloc_Allocate(allocator, size - zloc_AllocatorSize() - zloc__KILOBYTE(4));
+	if (!everything) {
+		result = 0;
+	}
+	zloc_Free(allocator, everything);
+	zloc_free_memory(memory);
+	return result;
+}
+#endif
+
+//These deliberately touch freed memory so keep them out of the sanitizer checks
+zloc__no_sanitize int TestQuarantineHoldsFreedBlocks(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_SetQuarantineSize(allocator, 4096);
+	void *allocations[10];
+	for (int i = 0; i != 10; ++i) {
+		allocations[i] = zloc_Allocate(allocator, 1000);
+	}
+	zloc_Free(allocator, allocations[0]);
+	//The freed block is still in quarantine so it can't be handed out again
+	void *reused = zloc_Allocate(allocator, 1000);
+	if (reused == allocations[0] || ((unsigned char*)allocations[0])[500] != ZLOC_QUARANTINE_POISON) {
+		result = 0;
+	}
+	zloc_Free(allocator, reused);
+	for (int i = 1; i != 10; ++i) {
+		zloc_Free(allocator, allocations[i]);
+	}
+	if (allocator->quarantine_bytes > 4096 || allocator->quarantine_bytes < 3000) {
+		result = 0;
+	}
+	zloc_FlushQuarantine(allocator);
+	if (allocator->quarantine_bytes || allocator->quarantine_head || zloc_VerifyBlocks(zloc__allocator_first_block(allocator), 0, 0) != zloc__OK) {
+		result = 0;
+	}
+	//Everything was really freed so the pool should be back to one block
+	void *everything = zloc_Allocate(allocator, size - zloc_AllocatorSize() - zloc__KILOBYTE(4));
+	if (!everything) {
+		result = 0;
+	}
+	zloc_Free(allocator, everything);
+	zloc_free_memory(memory);
+	return result;
+}
+
+static int use_after_free_calls = 0;
+static zloc_size use_after_free_offset = 0;
+void on_use_after_free(void *user_data, void *allocation, zloc_size size, zloc_size offset) {
+	use_after_free_calls++;
+	use_after_free_offset = offset;
+}
+
+zloc__no_sanitize int TestQuarantineCatchesWriteAfterFree(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_SetQuarantineSize(allocator, zloc__KILOBYTE(64));
+	zloc_SetUseAfterFreeCallback(allocator, on_use_after_free, 0);
+	use_after_free_calls = 0;
+	char *clean = (char*)zloc_Allocate(allocator, 256);
+	char *dirty = (char*)zloc_Allocate(allocator, 256);
+	zloc_Free(allocator, clean);
+	zloc_Free(allocator, dirty);
+	dirty[21] = 0;
+	//Shrinking the quarantine evicts the oldest first so only the clean block has been checked yet
+	zloc_SetQuarantineSize(allocator, zloc_UsableSize(dirty));
+	if (use_after_free_calls != 0) {
+		result = 0;
+	}
+	zloc_FlushQuarantine(allocator);
+	if (use_after_free_calls != 1 || use_after_free_offset != 21) {
+		result = 0;
+	}
+	zloc_SetQuarantineSize(allocator, 0);
+	zloc_free_memory(memory);
+	return result;
+}
+
+zloc__no_sanitize int TestQuarantineCatchesWriteAfterMovingReallocate(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_SetQuarantineSize(allocator, zloc__KILOBYTE(64));
+	zloc_SetUseAfterFreeCallback(allocator, on_use_after_free, 0);
+	use_after_free_calls = 0;
+	char *old = (char*)zloc_Allocate(allocator, 256);
+	//Pin the block after it so the reallocation has to move
+	void *pin = zloc_Allocate(allocator, 256);
+	char *moved = (char*)zloc_Reallocate(allocator, old, 4096);
+	if (!moved || moved == old || (unsigned char)old[100] != ZLOC_QUARANTINE_POISON || allocator->quarantine_bytes != zloc_UsableSize(old)) {
+		result = 0;
+	}
+	old[37] = 0;
+	zloc_FlushQuarantine(allocator);
+	if (use_after_free_calls != 1 || use_after_free_offset != 37) {
+		result = 0;
+	}
+	zloc_Free(allocator, moved);
+	zloc_Free(allocator, pin);
+	zloc_SetQuarantineSize(allocator, 0);
+	if (zloc_VerifyBlocks(zloc__allocator_first_block(allocator), 0, 0) != zloc__OK) {
+		result = 0;
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+#ifdef zloc__ASAN
+int TestPoisoningTracksAllocations(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	char *first = (char*)zloc_Allocate(allocator, 100);
+	char *second = (char*)zloc_Allocate(allocator, 100);
+	zloc_size usable = zloc_UsableSize(first);
+	//Only the allocation itself can be touched, not the header of the block after it
+	if (__asan_region_is_poisoned(first, usable) || !__asan_address_is_poisoned(first + usable) || !__asan_address_is_poisoned(second - 1)) {
+		result = 0;
+	}
+	second = (char*)zloc_Reallocate(allocator, second, 1000);
+	if (__asan_region_is_poisoned(second, 1000) || !__asan_address_is_poisoned(second + zloc_UsableSize(second))) {
+		result = 0;
+	}
+	second = (char*)zloc_Reallocate(allocator, second, 200);
+	if (__asan_region_is_poisoned(second, 200) || !__asan_address_is_poisoned(second + zloc_UsableSize(second))) {
+		result = 0;
+	}
+	zloc_Free(allocator, second);
+	zloc_Free(allocator, first);
+	if (!__asan_address_is_poisoned(first) || !__asan_address_is_poisoned(second)) {
+		result = 0;
+	}
+	zloc_RemovePool(allocator, zloc_GetPool(allocator));
+	zloc_free_memory(memory);
+	return result;
+}
+#endif
+
+zloc__no_sanitize int TestHeaderChecksumsCatchOverruns(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	corrupt_headers_found = 0;
+	char *first = (char*)zloc_Allocate(allocator, 100);
+	char *second = (char*)zloc_Allocate(allocator, 100);
+	char *third = (char*)zloc_Allocate(allocator, 100);
+	zloc_size usable = zloc_UsableSize(first);
+	//Byte by byte so that a sanitizer doesn't catch the overrun first
+	volatile char *overrun = first + usable;
+	char saved[sizeof(void*) * 2];
+	for (int i = 0; i != sizeof(saved); ++i) saved[i] = overrun[i];
+	//Overrun the first allocation by one word, into the second block's prev_physical_block
+	for (int i = 0; i != sizeof(void*); ++i) overrun[i] = (char)0xAB;
+	if (zloc_Free(allocator, first) != 0 || corrupt_headers_found != 1) {
+		result = 0;
+	}
+	//And by two words, into the size
+	for (int i = 0; i != sizeof(saved); ++i) overrun[i] = (char)0xAB;
+	if (zloc_Free(allocator, second) != 0 || zloc_Free(allocator, first) != 0 || corrupt_headers_found != 3) {
+		result = 0;
+	}
+	for (int i = 0; i != sizeof(saved); ++i) overrun[i] = saved[i];
+	if (!zloc_Free(allocator, first) || !zloc_Free(allocator, third) || !zloc_Free(allocator, second) || corrupt_headers_found != 3) {
+		result = 0;
+	}
+	if (zloc_VerifyBlocks(zloc__allocator_first_block(allocator), 0, 0) != zloc__OK) {
+		result = 0;
+	}
+	corrupt_headers_found = 0;
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestVerifyStepWithAllocationsInBetween(zloc_uint iterations, zloc_random *random) {
+	zloc_size size = zloc__MEGABYTE(4);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_verify_cursor cursor;
+	zloc_InitialiseVerifyCursor(allocator, &cursor, zloc_GetPool(allocator));
+	void *allocations[256] = { 0 };
+	for (zloc_uint i = 0; i != iterations; ++i) {
+		//Allocate and free around the cursor so that the block it's on keeps getting merged away
+		int index = (int)_zloc_random_range(random, 255);
+		if (allocations[index]) {
+			zloc_Free(allocator, allocations[index]);
+			allocations[index] = 0;
+		} else {
+			allocations[index] = zloc_Allocate(allocator, (zloc_size)_zloc_random_range(random, 4096 - 16) + 16);
+		}
+		zloc_verify_result verify = zloc_VerifyStep(allocator, &cursor, 3);
+		if (verify != zloc_verify_in_progress && verify != zloc_verify_pass_complete) {
+			result = 0;
+			break;
+		}
+	}
+	if (cursor.passes == 0) {
+		result = 0;
+	}
+	zloc_ReleaseVerifyCursor(allocator, &cursor);
+	for (int i = 0; i != 256; ++i) {
+		zloc_Free(allocator, allocations[i]);
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestReleasedVerifyCursorIsLeftAlone(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	void *first = zloc_Allocate(allocator, 64);
+	void *second = zloc_Allocate(allocator, 64);
+	zloc_verify_cursor cursor;
+	zloc_InitialiseVerifyCursor(allocator, &cursor, zloc_GetPool(allocator));
+	//Leave the cursor on the second block, which gets merged into the first when they're both freed
+	zloc_VerifyStep(allocator, &cursor, 1);
+	zloc_ReleaseVerifyCursor(allocator, &cursor);
+	if (allocator->verify_cursor || zloc_VerifyStep(allocator, &cursor, 1) != zloc_verify_pass_complete) {
+		result = 0;
+	}
+	//Stands in for the cursor's memory being reused after it went out of scope
+	memset(&cursor, 0xAB, sizeof(cursor));
+	zloc_Free(allocator, first);
+	zloc_Free(allocator, second);
+	const unsigned char *bytes = (const unsigned char*)&cursor;
+	for (size_t i = 0; i != sizeof(cursor); ++i) {
+		if (bytes[i] != 0xAB) {
+			result = 0;
+		}
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+zloc__no_sanitize int TestVerifyStepFindsCorruption(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	void *allocations[10];
+	for (int i = 0; i != 10; ++i) {
+		allocations[i] = zloc_Allocate(allocator, 64);
+	}
+	zloc_Free(allocator, allocations[4]);
+	zloc_verify_cursor cursor;
+	zloc_InitialiseVerifyCursor(allocator, &cursor, zloc_GetPool(allocator));
+	//10 allocations, the rest of the pool and the end of pool block
+	if (zloc_VerifyStep(allocator, &cursor, 5) != zloc_verify_in_progress || zloc_VerifyStep(allocator, &cursor, 7) != zloc_verify_pass_complete || cursor.passes != 1) {
+		result = 0;
+	}
+	//Mark the block before the free one as free without telling the next block
+	zloc_header *block = zloc__block_from_allocation(allocations[3]);
+	zloc_size original_size = block->size;
+	zloc__block_set_free(block);
+	zloc_verify_result verify = zloc_VerifyStep(allocator, &cursor, 100);
+	if (verify != zloc_verify_bad_checksum && verify != zloc_verify_boundary_tag_mismatch) {
+		result = 0;
+	}
+	if (cursor.bad_block != block || cursor.block != zloc__allocator_first_block(allocator)) {
+		result = 0;
+	}
+	block->size = original_size;
+	zloc__block_set_used(block);
+	if (zloc_VerifyStep(allocator, &cursor, 100) != zloc_verify_pass_complete || cursor.passes != 2) {
+		result = 0;
+	}
+	zloc_ReleaseVerifyCursor(allocator, &cursor);
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestPoolPolicyDrainsHigherPool(void) {
+	int result = 1;
+	zloc_size pool_size = zloc__MEGABYTE(1);
+	void *allocator_memory = malloc(zloc_AllocatorSize());
+	char *pool_memory = (char*)malloc(pool_size * 2);
+	zloc_allocator *allocator = zloc_InitialiseAllocator(allocator_memory);
+	zloc_SetPoolPolicy(allocator, zloc_pool_policy_lowest_address);
+	//Added low then high so that the high pool would be the one used first by default
+	zloc_pool *low_pool = zloc_AddPool(allocator, pool_memory, pool_size);
+	zloc_pool *high_pool = zloc_AddPool(allocator, pool_memory + pool_size, pool_size);
+	void *allocations[40];
+	int count = 0;
+	while (count != 40 && (allocations[count] = zloc_Allocate(allocator, zloc__KILOBYTE(64)))) {
+		count++;
+	}
+	//15 fit in the low pool and the rest go in the high one
+	for (int i = 0; i != count; ++i) {
+		if (((char*)allocations[i] < pool_memory + pool_size) != (i < 15)) {
+			result = 0;
+		}
+	}
+	//Free one from each pool, the one in the high pool last so that it'd be the one reused by default
+	zloc_Free(allocator, allocations[3]);
+	zloc_Free(allocator, allocations[18]);
+	void *reused = zloc_Allocate(allocator, zloc__KILOBYTE(64));
+	if (reused != allocations[3]) {
+		result = 0;
+	}
+	allocations[18] = 0;
+	for (int i = 15; i != count; ++i) {
+		zloc_Free(allocator, allocations[i]);
+	}
+	//Everything left is in the low pool so the high one can go
+	if (!zloc_RemovePool(allocator, high_pool) || zloc_VerifyBlocks(zloc__first_block_in_pool(low_pool), 0, 0) != zloc__OK) {
+		result = 0;
+	}
+	zloc_free_memory(pool_memory);
+	zloc_free_memory(allocator_memory);
+	return result;
+}
+
+int TestPoolPolicyWithRandomAllocations(zloc_uint iterations, zloc_random *random) {
+	int result = 1;
+	zloc_size size = zloc__MEGABYTE(4);
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_SetPoolPolicy(allocator, zloc_pool_policy_lowest_address);
+	void *allocations[100] = { 0 };
+	for (zloc_uint i = 0; i != iterations; ++i) {
+		int index = (int)_zloc_random_range(random, 100);
+		if (allocations[index]) {
+			zloc_Free(allocator, allocations[index]);
+			allocations[index] = 0;
+		} else {
+			allocations[index] = zloc_Allocate(allocator, (zloc_size)_zloc_random_range(random, 2048) + 1);
+		}
+	}
+	if (zloc_VerifyBlocks(zloc__allocator_first_block(allocator), 0, 0) != zloc__OK) {
+		result = 0;
+	}
+	//Blocks inserted part way down the lists still need to merge back into one
+	for (int i = 0; i != 100; ++i) {
+		zloc_Free(allocator, allocations[i]);
+	}
+	if (allocator->stats.free_blocks != 1) {
+		result = 0;
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestPoolRegistryFindsOwner(void) {
+	int result = 1;
+	zloc_size registry_memory_size = zloc__KILOBYTE(256);
+	void *registry_memory = malloc(registry_memory_size);
+	zloc_pool_registry registry;
+	zloc_InitialisePoolRegistry(&registry, registry_memory, registry_memory_size);
+	//Two allocators, one with its own pool and 8 small pools side by side that all share granules
+	zloc_size size = zloc__MEGABYTE(1);
+	void *memory = malloc(size);
+	zloc_allocator *big = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_size small_size = zloc__KILOBYTE(8);
+	char *small_memory = (char*)malloc(zloc_AllocatorSize() + small_size * 8);
+	zloc_allocator *small = zloc_InitialiseAllocator(small_memory);
+	char *small_pools = small_memory + zloc_AllocatorSize();
+	if (!zloc_RegisterPool(&registry, big, zloc_GetPool(big), size - zloc_AllocatorSize())) {
+		result = 0;
+	}
+	for (int i = 0; i != 8; ++i) {
+		zloc_AddPool(small, small_pools + small_size * i, small_size);
+		if (!zloc_RegisterPool(&registry, small, (zloc_pool*)(small_pools + small_size * i), small_size)) {
+			result = 0;
+		}
+	}
+	//Overlapping pools are turned away
+	if (zloc_RegisterPool(&registry, small, (zloc_pool*)(small_pools + 100), small_size)) {
+		result = 0;
+	}
+	void *allocations[8];
+	for (int i = 0; i != 8; ++i) {
+		allocations[i] = zloc_Allocate(small, zloc__KILOBYTE(6));
+	}
+	void *big_allocation = zloc_Allocate(big, zloc__KILOBYTE(100));
+	zloc_allocator *owner = 0;
+	if (zloc_LookupPool(&registry, big_allocation, &owner) != zloc_GetPool(big) || owner != big) {
+		result = 0;
+	}
+	for (int i = 0; i != 8; ++i) {
+		zloc_pool *pool = zloc_LookupPool(&registry, allocations[i], &owner);
+		if (!pool || owner != small || (char*)allocations[i] < (char*)pool || (char*)allocations[i] >= (char*)pool + small_size) {
+			result = 0;
+		}
+	}
+	int not_ours;
+	if (zloc_LookupPool(&registry, &not_ours, 0) || zloc_RegistryFree(&registry, &not_ours)) {
+		result = 0;
+	}
+	//Take one of the small pools out from the middle, its neighbours have to still be found
+	zloc_pool *middle = zloc_LookupPool(&registry, allocations[3], 0);
+	zloc_RegistryFree(&registry, allocations[3]);
+	if (!zloc_UnregisterPool(&registry, middle) || zloc_LookupPool(&registry, allocations[3], 0) || !zloc_RemovePool(small, middle)) {
+		result = 0;
+	}
+	if (zloc_LookupPool(&registry, allocations[2], 0) == 0 || zloc_LookupPool(&registry, allocations[4], 0) == 0 || registry.pool_count != 8) {
+		result = 0;
+	}
+	for (int i = 0; i != 8; ++i) {
+		if (i != 3 && !zloc_RegistryFree(&registry, allocations[i])) {
+			result = 0;
+		}
+	}
+	if (!zloc_RegistryFree(&registry, big_allocation) || big->stats.blocks_in_use != 0 || small->stats.blocks_in_use != 0) {
+		result = 0;
+	}
+	//The record is reused when the pool goes back in
+	zloc_size memory_used = registry.memory_used;
+	if (!zloc_RegisterPool(&registry, small, middle, small_size) || registry.memory_used != memory_used) {
+		result = 0;
+	}
+	zloc_free_memory(small_memory);
+	zloc_free_memory(memory);
+	zloc_free_memory(registry_memory);
+	return result;
+}
+
+int TestNumaAllocationsPreferLocalNode(void) {
+	int result = 1;
+	zloc_numa_allocator numa;
+	//Two nodes whether the machine has them or not, pools on a node the machine doesn't have just aren't bound
+	zloc_InitialiseNumaAllocator(&numa, 2);
+	if (!zloc_CreateNumaPool(&numa, 0, zloc__MEGABYTE(1)) || !zloc_CreateNumaPool(&numa, 1, zloc__MEGABYTE(1))) {
+		zloc_ReleaseNumaPools(&numa);
+		return 0;
+	}
+	test_numa_node = 1;
+	void *allocations[64];
+	int count = 0;
+	allocations[count++] = zloc_NumaAllocate(&numa, 1024);
+	if (zloc_NumaNodeOf(&numa, allocations[0]) != 1 || zloc_GetNumaNodeStats(&numa, 1).local_allocations != 1) {
+		result = 0;
+	}
+	//Keep going until node 1 is full and allocations start to come from node 0
+	while (count != 64) {
+		allocations[count] = zloc_NumaAllocate(&numa, zloc__KILOBYTE(64));
+		if (!allocations[count] || zloc_NumaNodeOf(&numa, allocations[count++]) == 0) {
+			break;
+		}
+	}
+	zloc_numa_stats node0 = zloc_GetNumaNodeStats(&numa, 0);
+	zloc_numa_stats node1 = zloc_GetNumaNodeStats(&numa, 1);
+	if (node0.remote_allocations != 1 || node0.local_allocations != 0 || node1.remote_allocations != 0 || node1.pools != 1) {
+		result = 0;
+	}
+	//Going back to node 0 means allocations from there are local again
+	test_numa_node = 0;
+	void *local = zloc_NumaAllocate(&numa, 1024);
+	if (zloc_NumaNodeOf(&numa, local) != 0 || zloc_GetNumaNodeStats(&numa, 0).local_allocations != 1) {
+		result = 0;
+	}
+	zloc_NumaFree(&numa, local);
+	for (int i = 0; i != count; ++i) {
+		if (!zloc_NumaFree(&numa, allocations[i])) {
+			result = 0;
+		}
+	}
+	if (zloc_GetNumaNodeStats(&numa, 0).free != node0.capacity || zloc_GetNumaNodeStats(&numa, 1).free != node1.capacity) {
+		result = 0;
+	}
+	zloc_ReleaseNumaPools(&numa);
+	return result;
+}
+
+int TestNumaPoolRegistryFindsNodes(void) {
+	int result = 1;
+	zloc_numa_allocator numa;
+	zloc_InitialiseNumaAllocator(&numa, 2);
+	zloc_size registry_size = zloc__KILOBYTE(256);
+	void *registry_memory = malloc(registry_size);
+	zloc_pool_registry *registry = malloc(sizeof(zloc_pool_registry));
+	zloc_InitialisePoolRegistry(registry, registry_memory, registry_size);
+	if (!zloc_CreateNumaPool(&numa, 0, zloc__MEGABYTE(1)) || !zloc_CreateNumaPool(&numa, 1, zloc__MEGABYTE(1))) {
 		result = 0;
 	}
-	else {
-		void *allocation = 0;
-		allocation = zloc_Reallocate(allocator, allocation, 1024);
-		if (!allocation) {
+	//Pools already added are registered straight away and any added after are registered as they're added
+	zloc_SetNumaPoolRegistry(&numa, registry);
+	if (!zloc_CreateNumaPool(&numa, 1, zloc__MEGABYTE(1)) || registry->pool_count != 3) {
+		result = 0;
+	}
+	void *allocations[3];
+	allocations[0] = zloc_NumaAllocateOnNode(&numa, 0, 1000);
+	allocations[1] = zloc_NumaAllocateOnNode(&numa, 1, 1000);
+	//Too big for the first pool on node 1 so it comes from the second
+	allocations[2] = zloc_NumaAllocateOnNode(&numa, 1, zloc__KILOBYTE(900));
+	zloc_allocator *allocator;
+	if (zloc_NumaNodeOf(&numa, allocations[0]) != 0 || zloc_NumaNodeOf(&numa, allocations[1]) != 1 || zloc_NumaNodeOf(&numa, allocations[2]) != 1 ||
+		!zloc_LookupPool(registry, allocations[2], &allocator) || allocator != numa.nodes[1].allocator) {
+		result = 0;
+	}
+	int not_ours;
+	if (zloc_NumaNodeOf(&numa, &not_ours) != -1) {
+		result = 0;
+	}
+	for (int i = 0; i != 3; ++i) {
+		if (!zloc_NumaFree(&numa, allocations[i])) {
 			result = 0;
 		}
+	}
+	zloc_ReleaseNumaPools(&numa);
+	if (registry->pool_count != 0) {
+		result = 0;
+	}
+	free(registry);
+	free(registry_memory);
+	return result;
+}
+
+int TestNumaSingleNodeFallback(void) {
+	int result = 1;
+	zloc_numa_allocator numa;
+	zloc_InitialiseNumaAllocator(&numa, 0);
+	if (numa.node_count < 1 || numa.node_count != zloc_NumaNodeCount()) {
+		result = 0;
+	}
+	zloc_size size = zloc__MEGABYTE(1);
+	void *memory = malloc(size);
+	if (!zloc_AddNumaPool(&numa, 0, memory, size)) {
+		free(memory);
+		return 0;
+	}
+	//A thread on a node with no pools, or one the allocator doesn't know about, still gets memory from node 0
+	test_numa_node = 5;
+	char *allocation = (char*)zloc_NumaAllocate(&numa, 100);
+	if (!allocation || zloc_NumaNodeOf(&numa, allocation) != 0) {
+		result = 0;
+	}
+	memset(allocation, 7, 100);
+	allocation = (char*)zloc_NumaReallocate(&numa, allocation, 4000);
+	if (!allocation || allocation[99] != 7 || zloc_NumaNodeOf(&numa, allocation) != 0) {
+		result = 0;
+	}
+	int not_ours;
+	if (zloc_NumaNodeOf(&numa, &not_ours) != -1 || zloc_NumaFree(&numa, &not_ours)) {
+		result = 0;
+	}
+	zloc_NumaFree(&numa, allocation);
+	zloc_numa_stats stats = zloc_GetNumaNodeStats(&numa, 0);
+	if (stats.pools != 1 || stats.blocks_in_use != 0 || stats.free != stats.capacity) {
+		result = 0;
+	}
+	test_numa_node = 0;
+	zloc_ReleaseNumaPools(&numa);
+	free(memory);
+	return result;
+}
+
+int TestSizeClassMappingMatchesFormula(void) {
+	//zloc__map picks between the small and large class formulas with a mask, check it against the plain branching version
+	//for every size up to 64kb and either side of every power of 2 after that
+	for (zloc_size size = 0; size <= zloc__KILOBYTE(64) + zloc__KILOBYTE(64) * (ZLOC_MAX_SIZE_INDEX - 16); ++size) {
+		zloc_size test_size = size;
+		if (size > zloc__KILOBYTE(64)) {
+			zloc_size step = size - zloc__KILOBYTE(64);
+			zloc_size power = ZLOC_ONE << (16 + step / zloc__KILOBYTE(64));
+			test_size = power + (step % zloc__KILOBYTE(64)) - zloc__KILOBYTE(32);
+		}
+		zloc_index fli, sli;
+		zloc__map(test_size, &fli, &sli);
+		zloc_index expected_fli = zloc__scan_reverse(test_size);
+		zloc_index expected_sli;
+		if (expected_fli <= zloc__SECOND_LEVEL_INDEX_LOG2) {
+			expected_fli = 0;
+			expected_sli = (int)test_size / (zloc__SMALLEST_CATEGORY / zloc__SECOND_LEVEL_INDEX_COUNT);
+		}
 		else {
-			result = 1;
+			expected_sli = (zloc_index)((test_size & ~(ZLOC_ONE << expected_fli)) >> (expected_fli - zloc__SECOND_LEVEL_INDEX_LOG2)) % zloc__SECOND_LEVEL_INDEX_COUNT;
+		}
+		if (fli != expected_fli || sli != expected_sli) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int TestIsZero(const void *memory, zloc_size from, zloc_size to) {
+	for (zloc_size i = from; i < to; ++i) {
+		if (((const char*)memory)[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+zloc__no_sanitize int TestAllocateZeroedSkipsZeroBlocks(void) {
+	int result = 1;
+	zloc_size pool_size = zloc__MEGABYTE(1);
+	void *allocator_memory = malloc(zloc_AllocatorSize());
+	void *pool_memory = calloc(1, pool_size);
+	zloc_allocator *allocator = zloc_InitialiseAllocator(allocator_memory);
+	zloc_AddZeroedPool(allocator, pool_memory, pool_size);
+	char *first = (char*)zloc_AllocateZeroed(allocator, 1000);
+	if (!first || !TestIsZero(first, 0, zloc_UsableSize(first))) {
+		result = 0;
+	}
+	//The rest of the pool is still known to be zero, so something written into it behind the allocator's back should
+	//still be there after the next zeroed allocation if the allocator really didn't clear it again
+	zloc_header *rest = zloc__next_physical_block(zloc__block_from_allocation(first));
+	if (!zloc__is_free_block(rest) || !zloc__zero_flag(rest)) {
+		result = 0;
+	}
+	((char*)zloc__block_user_ptr(rest))[100] = 1;
+	char *second = (char*)zloc_AllocateZeroed(allocator, 1000);
+	if (second != zloc__block_user_ptr(rest) || second[100] != 1 || !TestIsZero(second, 0, 100)) {
+		result = 0;
+	}
+	//Memory that's been used and freed is dirty so it has to be cleared
+	memset(first, 0xFF, 1000);
+	zloc_Free(allocator, first);
+	char *third = (char*)zloc_AllocateZeroed(allocator, 1000);
+	if (third != first || !TestIsZero(third, 0, zloc_UsableSize(third))) {
+		result = 0;
+	}
+	zloc_Free(allocator, second);
+	zloc_Free(allocator, third);
+	if (zloc_VerifyBlocks(zloc__first_block_in_pool((zloc_pool*)pool_memory), 0, 0) != zloc__OK) {
+		result = 0;
+	}
+	free(pool_memory);
+	free(allocator_memory);
+	return result;
+}
+
+int TestReallocateZeroedClearsGrowth(void) {
+	int result = 1;
+	zloc_size pool_size = zloc__MEGABYTE(1);
+	void *allocator_memory = malloc(zloc_AllocatorSize());
+	char *pool_memory = (char*)malloc(pool_size * 2);
+	memset(pool_memory, 0xAB, pool_size);
+	memset(pool_memory + pool_size, 0, pool_size);
+	zloc_allocator *allocator = zloc_InitialiseAllocator(allocator_memory);
+	zloc_AddPool(allocator, pool_memory, pool_size);
+	char *allocation = (char*)zloc_AllocateZeroed(allocator, 100);
+	memset(allocation, 'a', 100);
+	//Grows in place into dirty memory
+	allocation = (char*)zloc_ReallocateZeroed(allocator, allocation, 3000);
+	if (!allocation || allocation[99] != 'a' || !TestIsZero(allocation, 100, zloc_UsableSize(allocation))) {
+		result = 0;
+	}
+	//Block it in so that it has to move
+	char *neighbour = (char*)zloc_Allocate(allocator, 100);
+	memset(neighbour, 0xCD, 100);
+	char *moved = (char*)zloc_ReallocateZeroed(allocator, allocation, 20000);
+	if (!moved || moved == allocation || moved[99] != 'a' || !TestIsZero(moved, 100, zloc_UsableSize(moved))) {
+		result = 0;
+	}
+	zloc_Free(allocator, moved);
+	zloc_Free(allocator, neighbour);
+	//Grows in place into a zero block, only the old header of that block needs clearing
+	zloc_AddZeroedPool(allocator, pool_memory + pool_size, pool_size);
+	allocation = (char*)zloc_AllocateZeroed(allocator, zloc__KILOBYTE(700));
+	if (allocation < pool_memory + pool_size || !TestIsZero(allocation, 0, zloc_UsableSize(allocation))) {
+		result = 0;
+	}
+	memset(allocation, 'b', zloc__KILOBYTE(700));
+	allocation = (char*)zloc_ReallocateZeroed(allocator, allocation, zloc__KILOBYTE(900));
+	if (!allocation || allocation[zloc__KILOBYTE(700) - 1] != 'b' || !TestIsZero(allocation, zloc__KILOBYTE(700), zloc_UsableSize(allocation))) {
+		result = 0;
+	}
+	zloc_Free(allocator, allocation);
+	free(pool_memory);
+	free(allocator_memory);
+	return result;
+}
+
+int TestPurgeFreeMemoryZeroesFreeBlocks(void) {
+	int result = 1;
+	zloc_size pool_size = zloc__MEGABYTE(4);
+	void *allocator_memory = malloc(zloc_AllocatorSize());
+	char *pool_memory = (char*)malloc(pool_size);
+	zloc_allocator *allocator = zloc_InitialiseAllocator(allocator_memory);
+	zloc_AddPool(allocator, pool_memory, pool_size);
+	zloc_size size = zloc__MEGABYTE(3);
+	char *allocation = (char*)zloc_Allocate(allocator, size);
+	memset(allocation, 0x55, size);
+	zloc_Free(allocator, allocation);
+	zloc_size released = zloc_PurgeFreeMemory(allocator);
+	#ifdef __linux__
+	if (released < zloc__MEGABYTE(3)) {
+		result = 0;
+	}
+	#endif
+	//A plain allocation isn't cleared, so apart from the free list pointers it's zero because of the purge
+	allocation = (char*)zloc_Allocate(allocator, size);
+	if (!TestIsZero(allocation, sizeof(void*) * 2, size)) {
+		result = 0;
+	}
+	zloc_Free(allocator, allocation);
+	allocation = (char*)zloc_AllocateZeroed(allocator, size);
+	if (!TestIsZero(allocation, 0, zloc_UsableSize(allocation))) {
+		result = 0;
+	}
+	zloc_Free(allocator, allocation);
+	if (zloc_VerifyBlocks(zloc__first_block_in_pool((zloc_pool*)pool_memory), 0, 0) != zloc__OK) {
+		result = 0;
+	}
+	free(pool_memory);
+	free(allocator_memory);
+	return result;
+}
+
+int TestReallocateMovesLargeBlock(void) {
+	int result = 1;
+	zloc_size pool_size = ZLOC_STREAMING_COPY_THRESHOLD * 4;
+	void *allocator_memory = malloc(zloc_AllocatorSize());
+	void *pool_memory = malloc(pool_size);
+	zloc_allocator *allocator = zloc_InitialiseAllocator(allocator_memory);
+	zloc_AddPool(allocator, pool_memory, pool_size);
+	//Big enough to be copied with streaming stores and not a multiple of the 64 bytes they copy at a time
+	zloc_size size = ZLOC_STREAMING_COPY_THRESHOLD + 13;
+	unsigned char *allocation = (unsigned char*)zloc_Allocate(allocator, size);
+	for (zloc_size i = 0; i != size; ++i) {
+		allocation[i] = (unsigned char)(i * 7 + (i >> 12));
+	}
+	void *blocker = zloc_Allocate(allocator, 64);
+	unsigned char *moved = (unsigned char*)zloc_Reallocate(allocator, allocation, size * 2);
+	if (!moved || moved == allocation) {
+		result = 0;
+	}
+	for (zloc_size i = 0; moved && i != size; ++i) {
+		if (moved[i] != (unsigned char)(i * 7 + (i >> 12))) {
+			result = 0;
+			break;
+		}
+	}
+	zloc_Free(allocator, moved);
+	zloc_Free(allocator, blocker);
+	free(pool_memory);
+	free(allocator_memory);
+	return result;
+}
+
+int TestClassStatsCountAllocationsAndFrees(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	void *allocations[10];
+	for (int i = 0; i != 10; ++i) {
+		allocations[i] = zloc_Allocate(allocator, 100);
+	}
+	zloc_index fli, sli;
+	zloc__map(zloc_UsableSize(allocations[0]), &fli, &sli);
+	zloc_class_stats stats = zloc_GetClassStats(allocator, fli, sli);
+	//Nothing is free in the class to begin with so every allocation has to be split from the bigger pool block
+	if (stats.allocations != 10 || stats.frees != 0 || stats.live_bytes != 10 * zloc_UsableSize(allocations[0]) || stats.escalations != 10) {
+		result = 0;
+	}
+	if (zloc_ClassMinimumSize(fli, sli) > zloc_UsableSize(allocations[0])) {
+		result = 0;
+	}
+	//Freeing 2 neighbours merges them into one free block in a bigger class
+	zloc_Free(allocator, allocations[2]);
+	zloc_Free(allocator, allocations[3]);
+	stats = zloc_GetClassStats(allocator, fli, sli);
+	if (stats.frees != 2 || stats.live_bytes != 8 * zloc_UsableSize(allocations[0])) {
+		result = 0;
+	}
+	zloc_class_stats all_stats[zloc__FIRST_LEVEL_INDEX_COUNT][zloc__SECOND_LEVEL_INDEX_COUNT];
+	zloc_GetAllClassStats(allocator, all_stats);
+	zloc_size splits = 0, merges = 0;
+	for (int f = 0; f != zloc__FIRST_LEVEL_INDEX_COUNT; ++f) {
+		for (int s = 0; s != zloc__SECOND_LEVEL_INDEX_COUNT; ++s) {
+			splits += all_stats[f][s].splits;
+			merges += all_stats[f][s].merges;
 		}
 	}
+	if (splits != 10 || merges != 1 || all_stats[fli][sli].allocations != 10) {
+		result = 0;
+	}
 	zloc_free_memory(memory);
 	return result;
 }
 
-int TestAlignedAllocation(void) {
+//Resizing in place doesn't count as an allocation or free but moves the live bytes to the new class
+int TestClassStatsFollowReallocation(void) {
 	zloc_size size = zloc__MEGABYTE(1);
 	int result = 1;
 	void *memory = malloc(size);
 	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
-	if (!allocator) {
+	void *allocation = zloc_Allocate(allocator, 64);
+	zloc_index small_fli, small_sli, large_fli, large_sli;
+	zloc__map(zloc_UsableSize(allocation), &small_fli, &small_sli);
+	allocation = zloc_Reallocate(allocator, allocation, 4000);
+	zloc__map(zloc_UsableSize(allocation), &large_fli, &large_sli);
+	zloc_class_stats small_stats = zloc_GetClassStats(allocator, small_fli, small_sli);
+	zloc_class_stats large_stats = zloc_GetClassStats(allocator, large_fli, large_sli);
+	if (small_stats.allocations != 1 || small_stats.live_bytes != 0 || large_stats.allocations != 0 || large_stats.live_bytes != zloc_UsableSize(allocation)) {
 		result = 0;
 	}
-	else {
-		void *allocation = 0;
-		allocation = zloc_AllocateAligned(allocator, 1024, 64);
-		if (!allocation) {
-			result = 0;
+	zloc_Free(allocator, allocation);
+	large_stats = zloc_GetClassStats(allocator, large_fli, large_sli);
+	if (large_stats.frees != 1 || large_stats.live_bytes != 0) {
+		result = 0;
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+static zloc_size CountSplitsAndMerges(zloc_allocator *allocator) {
+	zloc_class_stats all_stats[zloc__FIRST_LEVEL_INDEX_COUNT][zloc__SECOND_LEVEL_INDEX_COUNT];
+	zloc_GetAllClassStats(allocator, all_stats);
+	zloc_size count = 0;
+	for (int f = 0; f != zloc__FIRST_LEVEL_INDEX_COUNT; ++f) {
+		for (int s = 0; s != zloc__SECOND_LEVEL_INDEX_COUNT; ++s) {
+			count += all_stats[f][s].splits + all_stats[f][s].merges;
 		}
-		else {
-			result = 1;
+	}
+	return count;
+}
+
+//Reallocating to the same size, or shrinking by too little to split, leaves a free neighbour alone
+int TestSameSizeReallocateLeavesNeighbourAlone(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	void *allocation = zloc_Allocate(allocator, 1000);
+	void *neighbour = zloc_Allocate(allocator, 1000);
+	void *pin = zloc_Allocate(allocator, 100);
+	zloc_Free(allocator, neighbour);
+	zloc_size splits_and_merges = CountSplitsAndMerges(allocator);
+	zloc_size usable_size = zloc_UsableSize(allocation);
+	if (zloc_Reallocate(allocator, allocation, 1000) != allocation || zloc_Reallocate(allocator, allocation, 999) != allocation ||
+		zloc_Shrink(allocator, allocation, 1000) != allocation || zloc_UsableSize(allocation) != usable_size || CountSplitsAndMerges(allocator) != splits_and_merges) {
+		result = 0;
+	}
+	//The neighbour is still the same free block
+	if (zloc_Allocate(allocator, 1000) != neighbour || zloc_VerifyBlocks(zloc__allocator_first_block(allocator), 0, 0) != zloc__OK) {
+		result = 0;
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
+int TestTraceRecordsEveryCall(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_trace_event events[16];
+	zloc_trace_buffer trace;
+	zloc_InitialiseTraceBuffer(&trace, events, 16);
+	zloc_SetTraceBuffer(allocator, &trace);
+	void *allocation1 = zloc_Allocate(allocator, 100);
+	void *allocation2 = zloc_AllocateAligned(allocator, 256, 128);
+	void *allocation3 = zloc_Allocate(allocator, 64);
+	void *reallocated = zloc_Reallocate(allocator, allocation1, 5000);
+	zloc_Free(allocator, allocation2);
+	zloc_Free(allocator, reallocated);
+	zloc_SetTraceBuffer(allocator, 0);
+	zloc_Free(allocator, allocation3);
+	zloc_trace_event recorded[16];
+	zloc_size count = zloc_GetTraceEvents(&trace, recorded, 16);
+	if (count != 6) {
+		result = 0;
+	}
+	else {
+		uint64_t offset1 = (uint64_t)((char*)allocation1 - (char*)allocator);
+		uint64_t offset2 = (uint64_t)((char*)allocation2 - (char*)allocator);
+		uint64_t reallocated_offset = (uint64_t)((char*)reallocated - (char*)allocator);
+		if (recorded[0].op != zloc_trace_op_allocate || recorded[0].size != 100 || recorded[0].offset != offset1) result = 0;
+		if (recorded[1].op != zloc_trace_op_allocate_aligned || recorded[1].alignment_log2 != 7 || recorded[1].offset != offset2) result = 0;
+		if (recorded[3].op != zloc_trace_op_reallocate || recorded[3].previous_offset != offset1 || recorded[3].offset != reallocated_offset) result = 0;
+		if (recorded[4].op != zloc_trace_op_free || recorded[4].previous_offset != offset2) result = 0;
+		if (recorded[5].op != zloc_trace_op_free || recorded[5].previous_offset != reallocated_offset) result = 0;
+		for (int i = 1; i != 6; ++i) {
+			if (recorded[i].timestamp < recorded[i - 1].timestamp || recorded[i].thread_id != recorded[0].thread_id) result = 0;
 		}
 	}
 	zloc_free_memory(memory);
 	return result;
 }
 
+typedef struct trace_flush_counter {
+	zloc_size flushes;
+	zloc_size events;
+} trace_flush_counter;
+
+static void on_trace_flush(void *user_data, const zloc_trace_event *events, zloc_size count) {
+	trace_flush_counter *counter = (trace_flush_counter*)user_data;
+	counter->flushes++;
+	counter->events += count;
+}
+
+//Without a callback the oldest events get overwritten, with one they're flushed when the buffer fills
+int TestTraceBufferWrapAndFlush(void) {
+	zloc_size size = zloc__MEGABYTE(1);
+	int result = 1;
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc_trace_event events[8];
+	zloc_trace_buffer trace;
+	zloc_InitialiseTraceBuffer(&trace, events, 8);
+	zloc_SetTraceBuffer(allocator, &trace);
+	for (int i = 0; i != 10; ++i) {
+		zloc_Free(allocator, zloc_Allocate(allocator, 16 + i));
+	}
+	zloc_trace_event recorded[8];
+	if (zloc_GetTraceEvents(&trace, recorded, 8) != 8 || trace.dropped != 12) {
+		result = 0;
+	}
+	//Oldest event left is the allocation from the 7th iteration
+	if (recorded[0].op != zloc_trace_op_allocate || recorded[0].size != 16 + 6 || recorded[7].op != zloc_trace_op_free) {
+		result = 0;
+	}
+	trace_flush_counter counter = { 0 };
+	zloc_InitialiseTraceBuffer(&trace, events, 8);
+	zloc_SetTraceFlushCallback(&trace, on_trace_flush, &counter);
+	for (int i = 0; i != 10; ++i) {
+		zloc_Free(allocator, zloc_Allocate(allocator, 16 + i));
+	}
+	if (counter.flushes != 2 || counter.events != 16 || trace.count != 4) {
+		result = 0;
+	}
+	zloc_FlushTraceBuffer(&trace);
+	if (counter.events != 20 || trace.count != 0 || trace.dropped != 0) {
+		result = 0;
+	}
+	zloc_free_memory(memory);
+	return result;
+}
+
 int TestFreeAllBuffersAndPools(zloc_allocator *allocator, void *memory[8], void *buffers[100]) {
 	int result = 1;
 
@@ -1572,6 +3157,124 @@ int TestRemoteMemoryReallocation(zloc_size pool_size, zloc_size minimum_remote_a
 	return result;
 }
 
+void on_move_block(void *user_data, zloc_header* block, zloc_header *new_block) {
+	remote_buffer *buffer = zloc_BlockUserExtensionPtr(block);
+	remote_buffer *new_buffer = zloc_BlockUserExtensionPtr(new_block);
+	new_buffer->data = (void*)((char*)new_buffer->pool + new_buffer->offset_from_pool);
+	//The ranges can overlap so memmove rather then memcpy
+	memmove(new_buffer->data, buffer->data, buffer->size);
+}
+
+int TestRemoteMemoryReallocationGrowBackwards(zloc_size pool_size, zloc_size minimum_remote_allocation_size) {
+	int result = 1;
+	remote_memory_pools pools;
+	pools.pool_sizes[0] = pool_size;
+	pools.pool_count = 0;
+	void *allocator_memory = malloc(zloc_AllocatorSize());
+	zloc_allocator *allocator = zloc_InitialiseAllocatorForRemote(allocator_memory);
+	zloc_SetBlockExtensionSize(allocator, sizeof(remote_buffer));
+	zloc_SetMinimumAllocationSize(allocator, minimum_remote_allocation_size);
+	allocator->remote_user_data = &pools;
+	allocator->add_pool_callback = on_add_pool;
+	allocator->split_block_callback = on_split_block;
+	allocator->unable_to_reallocate_callback = on_reallocation_copy;
+	allocator->move_block_callback = on_move_block;
+	zloc_size range_pool_size = zloc_CalculateRemoteBlockPoolSize(allocator, pool_size);
+	pools.range_pools[0] = malloc(range_pool_size);
+	pools.memory_pools[0] = malloc(pool_size);
+	zloc_AddRemotePool(allocator, pools.range_pools[0], range_pool_size, pool_size);
+	remote_buffer *buffers[3];
+	for (int i = 0; i != 3; ++i) {
+		buffers[i] = zloc_AllocateRemote(allocator, minimum_remote_allocation_size * 4);
+		buffers[i]->data = (void*)((char*)pools.memory_pools[0] + buffers[i]->offset_from_pool);
+		memset(buffers[i]->data, i + 1, buffers[i]->size);
+	}
+	zloc_size first_offset = buffers[0]->offset_from_pool;
+	zloc_FreeRemote(allocator, buffers[0]);
+	remote_buffer *grown = zloc_ReallocateRemote(allocator, buffers[1], minimum_remote_allocation_size * 6);
+	if (!grown || grown->offset_from_pool != first_offset || grown->size != minimum_remote_allocation_size * 6) {
+		result = 0;
+	}
+	else {
+		//The contents of the second buffer should have moved down to the start of the first
+		char *data = (char*)pools.memory_pools[0] + grown->offset_from_pool;
+		for (zloc_size i = 0; i != minimum_remote_allocation_size * 4; ++i) {
+			if (data[i] != 2) {
+				result = 0;
+				break;
+			}
+		}
+		remote_buffer *after = zloc_BlockUserExtensionPtr(zloc__next_physical_block(zloc__block_from_allocation(zloc_AllocationFromExtensionPtr(grown))));
+		if (after->offset_from_pool != grown->offset_from_pool + grown->size) {
+			result = 0;
+		}
+	}
+	zloc_VerifyPool(allocator, pools.range_pools[0]);
+	zloc_free_memory(pools.range_pools[0]);
+	zloc_free_memory(pools.memory_pools[0]);
+	zloc_free_memory(allocator_memory);
+	return result;
+}
+
+int TestRemoteMemoryHeapDump(zloc_size pool_size, zloc_size minimum_remote_allocation_size) {
+	int result = 1;
+	remote_memory_pools pools;
+	pools.pool_sizes[0] = pool_size;
+	pools.pool_count = 0;
+	void *allocator_memory = malloc(zloc_AllocatorSize());
+	zloc_allocator *allocator = zloc_InitialiseAllocatorForRemote(allocator_memory);
+	zloc_SetBlockExtensionSize(allocator, sizeof(remote_buffer));
+	zloc_SetMinimumAllocationSize(allocator, minimum_remote_allocation_size);
+	allocator->remote_user_data = &pools;
+	allocator->add_pool_callback = on_add_pool;
+	allocator->split_block_callback = on_split_block;
+	allocator->unable_to_reallocate_callback = on_reallocation_copy;
+	allocator->move_block_callback = on_move_block;
+	zloc_size range_pool_size = zloc_CalculateRemoteBlockPoolSize(allocator, pool_size);
+	pools.range_pools[0] = malloc(range_pool_size);
+	pools.memory_pools[0] = malloc(pool_size);
+	zloc_AddRemotePool(allocator, pools.range_pools[0], range_pool_size, pool_size);
+	remote_buffer *buffers[4];
+	for (int i = 0; i != 4; ++i) {
+		buffers[i] = zloc_AllocateRemote(allocator, minimum_remote_allocation_size * (i + 1));
+	}
+	zloc_FreeRemote(allocator, buffers[1]);
+	FILE *file = tmpfile();
+	if (!file || !zloc_WriteHeapDump(allocator, pools.range_pools[0], file)) {
+		result = 0;
+	}
+	else {
+		rewind(file);
+		zloc_heap_dump_header header;
+		if (fread(&header, sizeof(header), 1, file) != 1 || !(header.flags & zloc_heap_dump_remote) || header.pool_size != pool_size || header.block_count != 5) {
+			result = 0;
+		}
+		//The records should hold the remote offsets and sizes and cover the remote pool with no gaps
+		zloc_heap_dump_block records[5];
+		if (result && fread(records, sizeof(zloc_heap_dump_block), 5, file) == 5) {
+			zloc_size offset = 0;
+			for (int i = 0; i != 5; ++i) {
+				if (records[i].offset != offset) {
+					result = 0;
+				}
+				offset += records[i].size;
+			}
+			if (records[0].offset != buffers[0]->offset_from_pool || records[2].offset != buffers[2]->offset_from_pool || records[3].size != buffers[3]->size ||
+				records[1].flags != 0 || records[4].flags != 0 || !(records[0].flags & zloc_heap_dump_block_used) || offset != pool_size) {
+				result = 0;
+			}
+		}
+		else {
+			result = 0;
+		}
+		fclose(file);
+	}
+	zloc_free_memory(pools.range_pools[0]);
+	zloc_free_memory(pools.memory_pools[0]);
+	zloc_free_memory(allocator_memory);
+	return result;
+}
+
 int TestRemoteMemoryReallocationIterations(zloc_uint iterations, zloc_size pool_size, zloc_size minimum_remote_allocation_size, zloc_size min_allocation_size, zloc_size max_allocation_size, zloc_random *random) {
 	int result = 1;
 	remote_memory_pools pools;
@@ -1730,6 +3433,9 @@ int main() {
 	PrintTestResult("Test: Attempt to reallocate memory", TestReAllocation());
 	PrintTestResult("Test: Attempt to reallocate memory of null pointer (should just allocate instead)", TestReAllocationOfNullPtr());
 	PrintTestResult("Test: Attempt to reallocate where it has to fall back to allocate and copy", TestReAllocationFallbackToAllocateAndCopy());
+	PrintTestResult("Test: Reallocate grows backwards into a free previous block", TestReAllocationGrowBackwards());
+	PrintTestResult("Test: Reallocate grows into both free neighbouring blocks", TestReAllocationGrowBackwardsAndForwards());
+	PrintTestResult("Test: Shrink returns the tail to the free lists merged with the next free block", TestShrinkNextToFreeBlock());
 	PrintTestResult("Test: Multiple same size block allocations and frees", TestAllocateFreeSameSizeBlocks());
 	//PrintTestResult("Test: Try to free an invalid allocation address", TestFreeingAnInvalidAllocation());
 	//PrintTestResult("Test: Detect memory corruption by writing outside of bounds of an allocation (after)", TestMemoryCorruptionDetection());
@@ -1741,6 +3447,46 @@ int main() {
 	PrintTestResult("Test: Many random allocations and frees, go oom: 1000 iterations, 1GB pool size, max allocation: 2MB - 100MB", TestManyAllocationsAndFrees(1000, zloc__GIGABYTE(1), zloc__KILOBYTE(256), zloc__MEGABYTE(50), &random));
 	PrintTestResult("Test: Many random allocations and frees, go oom: 1000 iterations, 512MB pool size, max allocation: 2MB - 100MB", TestManyAllocationsAndFrees(1000, zloc__MEGABYTE(512), zloc__KILOBYTE(256), zloc__MEGABYTE(25), &random));
 	PrintTestResult("Test: Single aligned allocation", TestAlignedAllocation());
+	PrintTestResult("Test: Usable size of an allocation is at least the requested size and fully writable", TestUsableSize());
+	PrintTestResult("Test: Usable size includes the slack of a block that was too small to split", TestUsableSizeOfUnsplitBlock());
+	PrintTestResult("Test: Fragmentation report matches a full walk of the pool", TestFragmentationReport());
+	PrintTestResult("Test: Heap dump lists every block in the pool with its offset, size and state", TestHeapDump());
+	PrintTestResult("Test: Leak report groups the live allocations in every pool by size and tag, largest first", TestLeakReport());
+	PrintTestResult("Test: Tagged allocations count towards their tag's live bytes and keep their tag when reallocated", TestTaggedAllocationsCountLiveBytes());
+	PrintTestResult("Test: Tag budgets fail allocations that would go over or ask the over budget callback", TestTagBudgets());
+	PrintTestResult("Test: Tag budgets are checked against the size of the block that's charged", TestTagBudgetsChargeTheWholeBlock());
+	PrintTestResult("Test: Sampler with a 1 byte rate records every allocation grouped by callsite and writes folded stacks", TestSamplerGroupsByCallsite());
+	PrintTestResult("Test: Sampler takes about one sample per sample rate bytes and estimates the bytes allocated", TestSamplerEstimatesBytesAllocated());
+#ifdef zloc__ASAN
+	PrintTestResult("Test: Memory poisoning leaves only used allocations addressable", TestPoisoningTracksAllocations());
+#endif
+	PrintTestResult("Test: Verify step keeps its place while blocks are merged and split around it", TestVerifyStepWithAllocationsInBetween(10000, &random));
+	PrintTestResult("Test: Verify step checks a few blocks at a time and reports corruption", TestVerifyStepFindsCorruption());
+	PrintTestResult("Test: A released verify cursor isn't touched by later merges", TestReleasedVerifyCursorIsLeftAlone());
+	PrintTestResult("Test: Header checksums stop a free when an overrun has written over the next block's header", TestHeaderChecksumsCatchOverruns());
+	PrintTestResult("Test: Size class mapping matches the branching formula for small and large sizes", TestSizeClassMappingMatchesFormula());
+	PrintTestResult("Test: Zeroed allocations from a zero pool aren't cleared again, dirty ones are", TestAllocateZeroedSkipsZeroBlocks());
+	PrintTestResult("Test: Zeroed reallocation clears the growth whether it grows in place or moves", TestReallocateZeroedClearsGrowth());
+	PrintTestResult("Test: Purging free memory gives pages back and leaves the free blocks zero", TestPurgeFreeMemoryZeroesFreeBlocks());
+	PrintTestResult("Test: Reallocating a large block that has to move copies it all", TestReallocateMovesLargeBlock());
+	PrintTestResult("Test: Lowest address pool policy fills the low pool first so the high pool can be removed", TestPoolPolicyDrainsHigherPool());
+	PrintTestResult("Test: Lowest address pool policy, 10000 random allocations and frees", TestPoolPolicyWithRandomAllocations(10000, &random));
+	PrintTestResult("Test: Pool registry finds the pool and allocator of an allocation", TestPoolRegistryFindsOwner());
+	PrintTestResult("Test: NUMA allocations come from the calling thread's node until it's full", TestNumaAllocationsPreferLocalNode());
+	PrintTestResult("Test: NUMA allocator falls back to a single node", TestNumaSingleNodeFallback());
+	PrintTestResult("Test: NUMA pools in a pool registry are found by a registry lookup", TestNumaPoolRegistryFindsNodes());
+	PrintTestResult("Test: Quarantine holds on to freed blocks up to its size and really frees them when flushed", TestQuarantineHoldsFreedBlocks());
+	PrintTestResult("Test: Quarantine reports writes to a block after it was freed when the block is evicted", TestQuarantineCatchesWriteAfterFree());
+	PrintTestResult("Test: Quarantine reports writes through the old pointer after a reallocation moves the block", TestQuarantineCatchesWriteAfterMovingReallocate());
+#ifndef _WIN32
+	PrintTestResult("Test: Guard pages fault on a write past the end of an allocation", TestGuardPagesCatchOverruns());
+	PrintTestResult("Test: Guard page mode routes allocate, sized, tagged, aligned, reallocate and free through guarded allocations", TestGuardPagesMode());
+#endif
+	PrintTestResult("Test: Class stats count allocations, frees, live bytes, splits, merges and escalations", TestClassStatsCountAllocationsAndFrees());
+	PrintTestResult("Test: Class stats move live bytes between classes when reallocating in place", TestClassStatsFollowReallocation());
+	PrintTestResult("Test: Same size reallocations don't merge with and split off a free neighbour", TestSameSizeReallocateLeavesNeighbourAlone());
+	PrintTestResult("Test: Trace buffer records allocate, aligned, reallocate and free calls in order", TestTraceRecordsEveryCall());
+	PrintTestResult("Test: Trace buffer overwrites the oldest events or flushes to a callback when full", TestTraceBufferWrapAndFlush());
 	PrintTestResult("Test: Many random aligned allocations and frees 1000 iterations, 128MB pool size, max allocation: 256b - 2mb", TestManyRandomAlignedAllocations(1000, zloc__MEGABYTE(128), 256, zloc__MEGABYTE(2), &random));
 	PrintTestResult("Test: Many random aligned allocations and frees 1000 iterations, 128MB pool size, max allocation: 2kb - 4mb", TestManyRandomAlignedAllocations(1000, zloc__MEGABYTE(128), zloc__KILOBYTE(2), zloc__MEGABYTE(4), &random));
 	PrintTestResult("Test: Many random aligned allocations and frees, add pools as needed: 1000 iterations, 128MB pool size, max allocation: 64kb - 1MB", TestManyAlignedAllocationsAndFreesAddPools(1000, zloc__MEGABYTE(128), 64 * 1024, zloc__MEGABYTE(1), &random));
@@ -1777,6 +3523,8 @@ int main() {
 	PrintTestResult("Test: Remote memory management, 10000 iterations, allocate 256kb - 2mb, add 64mb pools as needed.", TestRemoteMemoryBlockManagement(10000, zloc__MEGABYTE(64), zloc__KILOBYTE(256), zloc__KILOBYTE(256), zloc__MEGABYTE(2), &random));
 	PrintTestResult("Test: Remote memory management, 10000 iterations, allocate 1MB - 64mb, add 128mb pools as needed.", TestRemoteMemoryBlockManagement(10000, zloc__MEGABYTE(128), zloc__MEGABYTE(1), zloc__MEGABYTE(1), zloc__MEGABYTE(64), &random));
 	PrintTestResult("Test: Remote memory management, Reallocation", TestRemoteMemoryReallocation(zloc__MEGABYTE(16), zloc__KILOBYTE(1)));
+	PrintTestResult("Test: Remote memory management, Reallocation grows backwards into a free previous block", TestRemoteMemoryReallocationGrowBackwards(zloc__MEGABYTE(16), zloc__KILOBYTE(1)));
+	PrintTestResult("Test: Remote memory management, Heap dump holds the remote offsets and sizes", TestRemoteMemoryHeapDump(zloc__MEGABYTE(16), zloc__KILOBYTE(1)));
 	PrintTestResult("Test: Remote memory management, Reallocation until full 10000 iterations 512b - 4kb", TestRemoteMemoryReallocationIterations(10000, zloc__MEGABYTE(16), 512, 512, zloc__KILOBYTE(4), &random));
 	PrintTestResult("Test: Remote memory management, Reallocation until full 10000 iterations 256kb - 2MB", TestRemoteMemoryReallocationIterations(10000, zloc__MEGABYTE(16), zloc__KILOBYTE(256), zloc__KILOBYTE(256), zloc__MEGABYTE(2), &random));
 	PrintTestResult("Test: Remote memory management, Reallocation until full 10000 iterations 256kb - 4MB", TestRemoteMemoryReallocationIterations(10000, zloc__MEGABYTE(64), zloc__KILOBYTE(256), zloc__KILOBYTE(256), zloc__MEGABYTE(4), &random));
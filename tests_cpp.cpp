@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <map>
+
+#define ZLOC_ERROR_COLOR "\033[90m"
+#define ZLOC_THREAD_SAFE
+#define ZLOC_EXTRA_DEBUGGING
+#define ZLOC_SAFEGUARDS
+#include "zloc.hpp"
+#define ZLOC_IMPLEMENTATION
+#include "zloc.h"
+
+#define PrintTestResult(message, expr) do { \
+	printf("%s", (message)); fflush(stdout); \
+	int _zloc_test_result = (expr); \
+	printf("%s [%s]\033[0m\n", _zloc_test_result == 0 ? "\033[31m" : "\033[32m", _zloc_test_result == 0 ? "FAILED" : "PASSED"); \
+	fflush(stdout); \
+} while (0)
+
+static zloc_allocator *stl_test_allocator;
+
+struct stl_test_heap {
+	static zloc_allocator *instance() { return stl_test_allocator; }
+};
+
+int TestStlAllocatorContainers(void) {
+	int result = 1;
+	zloc_size size = zloc__MEGABYTE(4);
+	void *memory = malloc(size);
+	stl_test_allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	{
+		std::vector<int, zloc::stl_allocator<int, stl_test_heap>> ints;
+		std::map<int, double, std::less<int>, zloc::stl_allocator<std::pair<const int, double>, stl_test_heap>> doubles;
+		//No per container overhead from the allocator
+		if (sizeof(ints) != sizeof(std::vector<int>)) result = 0;
+		for (int i = 0; i != 5000; ++i) {
+			ints.push_back(i);
+			doubles[i] = i * 0.5;
+		}
+		for (int i = 0; i != 5000; ++i) {
+			if (ints[i] != i || doubles[i] != i * 0.5) result = 0;
+		}
+	}
+	zloc_VerifyPool(stl_test_allocator, zloc_GetPool(stl_test_allocator));
+	if (stl_test_allocator->stats.free != stl_test_allocator->stats.capacity) result = 0;
+	free(memory);
+	return result;
+}
+
+int TestStlAllocatorAllocateAtLeast(void) {
+	int result = 1;
+	zloc_size size = zloc__MEGABYTE(1);
+	void *memory = malloc(size);
+	stl_test_allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	zloc::stl_allocator<char, stl_test_heap> allocator;
+	zloc::allocation_result<char*> allocation = allocator.allocate_at_least(13);
+	if (!allocation.ptr || allocation.count < 13) result = 0;
+	if (allocation.count != zloc_UsableSize(allocation.ptr)) result = 0;
+	//The whole of the reported size must be writable without damaging the allocator
+	memset(allocation.ptr, 7, allocation.count);
+	allocator.deallocate(allocation.ptr, allocation.count);
+	zloc_VerifyPool(stl_test_allocator, zloc_GetPool(stl_test_allocator));
+	free(memory);
+	return result;
+}
+
+#ifdef ZLOC_HAS_PMR
+struct alignas(64) aligned_thing {
+	float values[16];
+};
+
+int TestPmrVectorOnTlsfResource(void) {
+	int result = 1;
+	zloc_size size = zloc__MEGABYTE(4);
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	{
+		zloc::tlsf_resource resource(allocator);
+		std::pmr::vector<int> ints(&resource);
+		for (int i = 0; i != 10000; ++i) {
+			ints.push_back(i);
+		}
+		for (int i = 0; i != 10000; ++i) {
+			if (ints[i] != i) result = 0;
+		}
+		if (allocator->stats.blocks_in_use < 1) result = 0;
+	}
+	zloc_VerifyPool(allocator, zloc_GetPool(allocator));
+	if (allocator->stats.free != allocator->stats.capacity) result = 0;
+	free(memory);
+	return result;
+}
+
+int TestPmrOverAlignedOnTlsfResource(void) {
+	int result = 1;
+	zloc_size size = zloc__MEGABYTE(4);
+	void *memory = malloc(size);
+	zloc_allocator *allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+	{
+		zloc::tlsf_resource resource(allocator);
+		std::pmr::vector<aligned_thing> things(&resource);
+		for (int i = 0; i != 100; ++i) {
+			things.emplace_back();
+			if (((uintptr_t)things.data() & 63) != 0) result = 0;
+		}
+	}
+	zloc_VerifyPool(allocator, zloc_GetPool(allocator));
+	free(memory);
+	return result;
+}
+
+int TestPmrUnorderedMapOnPoolResource(void) {
+	int result = 1;
+	{
+		zloc::pool_resource resource(zloc__KILOBYTE(64));
+		std::pmr::unordered_map<int, std::pmr::string> map(&resource);
+		for (int i = 0; i != 5000; ++i) {
+			map.emplace(i, std::pmr::string("a string that is long enough to allocate", &resource));
+		}
+		for (int i = 0; i != 5000; i += 2) {
+			map.erase(i);
+		}
+		if (map.size() != 2500) result = 0;
+		if (map.find(1) == map.end() || map.find(2) != map.end()) result = 0;
+	}
+	return result;
+}
+
+int TestPmrPoolResourceLargeAllocation(void) {
+	int result = 1;
+	zloc::pool_resource resource(zloc__KILOBYTE(16));
+	void *large = resource.allocate(zloc__MEGABYTE(1), 256);
+	if (!large || ((uintptr_t)large & 255) != 0) result = 0;
+	memset(large, 7, zloc__MEGABYTE(1));
+	resource.deallocate(large, zloc__MEGABYTE(1), 256);
+	return result;
+}
+
+int TestPmrPoolResourceOddPoolSize(void) {
+	int result = 1;
+	//A pool size that isn't a multiple of the alignment still gives properly sized pools
+	zloc::pool_resource resource(zloc__KILOBYTE(16) + 13);
+	void *allocations[100];
+	for (int i = 0; i != 100; ++i) {
+		allocations[i] = resource.allocate(1000, 8);
+		memset(allocations[i], i, 1000);
+	}
+	for (int i = 0; i != 100; ++i) {
+		if (((unsigned char*)allocations[i])[999] != i) result = 0;
+		resource.deallocate(allocations[i], 1000, 8);
+	}
+	return result;
+}
+
+int TestPmrLinearResource(void) {
+	int result = 1;
+	char buffer[4096];
+	zloc_linear_allocator_t linear;
+	zloc_InitialiseLinearAllocator(&linear, buffer, sizeof(buffer));
+	zloc::linear_resource resource(&linear);
+	void *a = resource.allocate(100, 8);
+	void *b = resource.allocate(64, 64);
+	if (!a || !b) result = 0;
+	if (((uintptr_t)b & 63) != 0) result = 0;
+	resource.deallocate(a, 100, 8);
+	if ((char*)b < buffer || (char*)b + 64 > buffer + sizeof(buffer)) result = 0;
+	try {
+		if (resource.allocate(8192, 8)) result = 0;
+	} catch (const std::bad_alloc &) {
+	}
+	return result;
+}
+#endif
+
+int main() {
+	PrintTestResult("Test: stl_allocator with std::vector and std::map, all memory returned", TestStlAllocatorContainers());
+	PrintTestResult("Test: stl_allocator allocate_at_least reports the usable block size", TestStlAllocatorAllocateAtLeast());
+#ifdef ZLOC_HAS_PMR
+	PrintTestResult("Test: pmr vector on tlsf_resource, 10000 push_backs, all memory returned", TestPmrVectorOnTlsfResource());
+	PrintTestResult("Test: pmr vector of 64 byte aligned type on tlsf_resource", TestPmrOverAlignedOnTlsfResource());
+	PrintTestResult("Test: pmr unordered_map on growing pool_resource", TestPmrUnorderedMapOnPoolResource());
+	PrintTestResult("Test: pool_resource grows to fit an allocation larger than the pool size", TestPmrPoolResourceLargeAllocation());
+	PrintTestResult("Test: pool_resource with a pool size that isn't a multiple of the alignment", TestPmrPoolResourceOddPoolSize());
+	PrintTestResult("Test: linear_resource honours alignment and throws when exhausted", TestPmrLinearResource());
+#endif
+	return 0;
+}
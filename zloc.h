@@ -93,6 +93,10 @@ typedef size_t zloc_fl_bitmap;
 #endif
 #endif
 
+#if defined(ZLOC_ENABLE_ZERO_TRACKING) && MEMORY_ALIGNMENT_LOG2 < 3
+#error "ZLOC_ENABLE_ZERO_TRACKING keeps a flag in the block size so MEMORY_ALIGNMENT_LOG2 needs to be at least 3"
+#endif
+
 #ifndef ZLOC_ERROR_NAME
 #define ZLOC_ERROR_NAME "Allocator Error"
 #endif
@@ -122,24 +126,116 @@ typedef size_t zloc_fl_bitmap;
 
 zloc__static_assert(ZLOC_MAX_SIZE_INDEX < 64);
 
+#ifdef ZLOC_ENABLE_MEMORY_POISONING
+#if defined(__SANITIZE_ADDRESS__)
+#define zloc__ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define zloc__ASAN
+#endif
+#endif
+#if defined(zloc__ASAN)
+#include <sanitizer/asan_interface.h>
+//Block headers are poisoned too so the allocator's own code has to be left out of the address checks
+#ifdef _MSC_VER
+#define zloc__no_sanitize __declspec(no_sanitize_address)
+#else
+#define zloc__no_sanitize __attribute__((no_sanitize_address))
+#endif
+#define zloc__poison_memory(ptr, size) ASAN_POISON_MEMORY_REGION(ptr, size)
+#define zloc__unpoison_memory(ptr, size) ASAN_UNPOISON_MEMORY_REGION(ptr, size)
+#elif defined(ZLOC_VALGRIND)
+#include <valgrind/memcheck.h>
+#define zloc__poison_memory(ptr, size) VALGRIND_MAKE_MEM_NOACCESS(ptr, size)
+#define zloc__unpoison_memory(ptr, size) VALGRIND_MAKE_MEM_DEFINED(ptr, size)
+#else
+//No tool to tell, but still use the arguments so that the poisoning code doesn't leave unused variables behind
+#define zloc__poison_memory(ptr, size) ((void)(ptr), (void)(size))
+#define zloc__unpoison_memory(ptr, size) ((void)(ptr), (void)(size))
+#endif
+#endif
+
+#ifndef zloc__no_sanitize
+#define zloc__no_sanitize
+#endif
+
+//How far down a free list zloc_pool_policy_lowest_address looks for the place to put a freed block
+#ifndef ZLOC_ADDRESS_ORDER_SEARCH
+#define ZLOC_ADDRESS_ORDER_SEARCH 16
+#endif
+
+//Used to keep the allocator's lock away from the data it protects
+#ifndef ZLOC_CACHE_LINE_SIZE
+#define ZLOC_CACHE_LINE_SIZE 64
+#endif
+
+//Pool registry, each level of the radix tree below the root indexes ZLOC_REGISTRY_NODE_BITS bits of the address
+#ifndef ZLOC_REGISTRY_GRANULE_LOG2
+#define ZLOC_REGISTRY_GRANULE_LOG2 16
+#endif
+#if defined(zloc__64BIT)
+#ifndef ZLOC_REGISTRY_ADDRESS_BITS
+#define ZLOC_REGISTRY_ADDRESS_BITS 48
+#endif
+#ifndef ZLOC_REGISTRY_NODE_BITS
+#define ZLOC_REGISTRY_NODE_BITS 10
+#endif
+#else
+#ifndef ZLOC_REGISTRY_ADDRESS_BITS
+#define ZLOC_REGISTRY_ADDRESS_BITS 32
+#endif
+#ifndef ZLOC_REGISTRY_NODE_BITS
+#define ZLOC_REGISTRY_NODE_BITS 8
+#endif
+#endif
+#define zloc__REGISTRY_ROOT_BITS (ZLOC_REGISTRY_ADDRESS_BITS - ZLOC_REGISTRY_GRANULE_LOG2 - 2 * ZLOC_REGISTRY_NODE_BITS)
+zloc__static_assert(zloc__REGISTRY_ROOT_BITS >= 0);
+
+#if defined(ZLOC_ENABLE_TAGGING) && !defined(ZLOC_MAX_TAGS)
+#define ZLOC_MAX_TAGS 32
+#endif
+
+#ifdef ZLOC_ENABLE_SAMPLING
+#ifndef ZLOC_SAMPLE_MAX_FRAMES
+#define ZLOC_SAMPLE_MAX_FRAMES 16
+#endif
+#ifndef ZLOC_SAMPLE_CALLSITES
+#define ZLOC_SAMPLE_CALLSITES 512
+#endif
+zloc__static_assert(zloc__is_pow2(ZLOC_SAMPLE_CALLSITES));
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define zloc__MAXIMUM_BLOCK_SIZE (ZLOC_ONE << ZLOC_MAX_SIZE_INDEX)
 
+//Size of the optional fields in the block header that come after the size
+#ifdef ZLOC_SAFEGUARDS
+#define zloc__SAFEGUARD_FIELD_SIZE sizeof(void*)
+#else
+#define zloc__SAFEGUARD_FIELD_SIZE 0
+#endif
+#ifdef ZLOC_ENABLE_TAGGING
+#define zloc__TAG_FIELD_SIZE sizeof(zloc_size)
+#else
+#define zloc__TAG_FIELD_SIZE 0
+#endif
+#ifdef ZLOC_ENABLE_HEADER_CHECKSUMS
+#define zloc__CHECKSUM_FIELD_SIZE sizeof(zloc_size)
+#else
+#define zloc__CHECKSUM_FIELD_SIZE 0
+#endif
+#define zloc__HEADER_FIELDS_SIZE (zloc__SAFEGUARD_FIELD_SIZE + zloc__TAG_FIELD_SIZE + zloc__CHECKSUM_FIELD_SIZE)
+
 enum zloc__constants {
 	zloc__MEMORY_ALIGNMENT = 1 << MEMORY_ALIGNMENT_LOG2,
 	zloc__SECOND_LEVEL_INDEX_LOG2 = 5,
 	zloc__FIRST_LEVEL_INDEX_COUNT = ZLOC_MAX_SIZE_INDEX,
 	zloc__SECOND_LEVEL_INDEX_COUNT = 1 << zloc__SECOND_LEVEL_INDEX_LOG2,
-	#ifdef ZLOC_SAFEGUARDS
-	zloc__BLOCK_POINTER_OFFSET = sizeof(void*) * 2 + sizeof(zloc_size),
-	zloc__BLOCK_SIZE_OVERHEAD = sizeof(zloc_size) + sizeof(void*),
-	#else
-	zloc__BLOCK_POINTER_OFFSET = sizeof(void*) + sizeof(zloc_size),
-	zloc__BLOCK_SIZE_OVERHEAD = sizeof(zloc_size),
-	#endif
+	zloc__BLOCK_POINTER_OFFSET = sizeof(void*) + sizeof(zloc_size) + zloc__HEADER_FIELDS_SIZE,
+	zloc__BLOCK_SIZE_OVERHEAD = sizeof(zloc_size) + zloc__HEADER_FIELDS_SIZE,
 	zloc__MINIMUM_BLOCK_SIZE = 16,
 	zloc__POINTER_SIZE = sizeof(void*),
 	zloc__SMALLEST_CATEGORY = (1 << (zloc__SECOND_LEVEL_INDEX_LOG2 + MEMORY_ALIGNMENT_LOG2))
@@ -148,8 +244,15 @@ enum zloc__constants {
 typedef enum zloc__boundary_tag_flags {
 	zloc__BLOCK_IS_FREE = 1 << 0,
 	zloc__PREV_BLOCK_IS_FREE = 1 << 1,
+	zloc__BLOCK_IS_ZERO = 1 << 2,		//Only used with ZLOC_ENABLE_ZERO_TRACKING
 } zloc__boundary_tag_flags;
 
+#ifdef ZLOC_ENABLE_ZERO_TRACKING
+#define zloc__BLOCK_FLAGS (zloc__BLOCK_IS_FREE | zloc__PREV_BLOCK_IS_FREE | zloc__BLOCK_IS_ZERO)
+#else
+#define zloc__BLOCK_FLAGS (zloc__BLOCK_IS_FREE | zloc__PREV_BLOCK_IS_FREE)
+#endif
+
 typedef enum zloc__error_codes {
 	zloc__OK,
 	zloc__INVALID_FIRST_BLOCK,
@@ -178,6 +281,14 @@ typedef struct zloc_header {
 	#ifdef ZLOC_SAFEGUARDS
 	struct zloc_allocator *allocator;
 	#endif
+	#ifdef ZLOC_ENABLE_TAGGING
+	//Which subsystem owns the block, only meaningful while the block is in use
+	zloc_size tag;
+	#endif
+	#ifdef ZLOC_ENABLE_HEADER_CHECKSUMS
+	//Hash of the size and prev_physical_block, updated whenever either of them changes
+	zloc_size checksum;
+	#endif
 	/*
 	User allocation will start here when the block is used. When the block is free prev and next
 	are pointers in a linked list of free blocks within the same class size of blocks
@@ -193,34 +304,325 @@ typedef struct zloc_allocation_stats_t {
 	int free_blocks;
 } zloc_allocation_stats_t;
 
+#ifdef ZLOC_ENABLE_CLASS_STATS
+/*
+	Counters for one size class (one fli/sli pair). Allocations and frees are counted against the class of the block's
+	size when it's handed out or given back, live_bytes is the total size of used blocks in the class. Splits are
+	counted against the class of the block before it was split and merges against the class of the merged block.
+	Escalations count how often a request for this class had to be served from a bigger class.
+*/
+typedef struct zloc_class_stats {
+	zloc_size allocations;
+	zloc_size frees;
+	zloc_size live_bytes;
+	zloc_size splits;
+	zloc_size merges;
+	zloc_size escalations;
+} zloc_class_stats;
+#endif
+
+#ifdef ZLOC_ENABLE_TAGGING
+/*
+	Called when an allocation would take a tag over its budget. live_bytes is what the tag has in use now and size is
+	how much more the allocation needs, which is the size of the block it would be given and can be more then was asked
+	for. Return 1 to let the allocation go ahead anyway or 0 to fail it. It's called with the allocator locked so it
+	mustn't call back into the allocator.
+*/
+typedef zloc_bool(*zloc_tag_over_budget_callback)(void *user_data, zloc_uint tag, zloc_size live_bytes, zloc_size size);
+#endif
+
+#ifdef ZLOC_ENABLE_QUARANTINE
+#ifndef ZLOC_QUARANTINE_POISON
+#define ZLOC_QUARANTINE_POISON 0xDD
+#endif
+/*
+	Called when a block leaves the quarantine and the poison it was filled with has been changed, which means something
+	wrote to the allocation after it was freed. offset is where the first changed byte is from the start of the
+	allocation. It's called with the allocator locked so it mustn't call back into the allocator.
+*/
+typedef void(*zloc_use_after_free_callback)(void *user_data, void *allocation, zloc_size size, zloc_size offset);
+#endif
+
+#ifdef ZLOC_ENABLE_TRACING
+typedef enum zloc_trace_op {
+	zloc_trace_op_allocate,
+	zloc_trace_op_free,
+	zloc_trace_op_reallocate,
+	zloc_trace_op_allocate_aligned
+} zloc_trace_op;
+
+/*
+	One recorded call into the allocator. Pointers are stored as offsets from the allocator so that a trace can be
+	replayed into an allocator at a different address, 0 means a null pointer. Fixed size fields so that traces can be
+	read back by a build with a different word size.
+*/
+typedef struct zloc_trace_event {
+	uint64_t timestamp;			//Nanoseconds, only meaningful relative to other events
+	uint64_t size;				//Size that was requested
+	uint64_t offset;			//The allocation that was returned (0 for frees and failed calls)
+	uint64_t previous_offset;	//The allocation that was passed in for frees and reallocations
+	uint32_t thread_id;
+	uint8_t op;					//zloc_trace_op
+	uint8_t alignment_log2;		//Only set for aligned allocations
+	uint16_t reserved;
+} zloc_trace_event;
+
+typedef void(*zloc_trace_flush_callback)(void *user_data, const zloc_trace_event *events, zloc_size count);
+
+/*
+	Events are recorded into a buffer that you provide. Without a flush callback the buffer is a ring and the oldest
+	events are overwritten once it's full. With a flush callback, the events are handed to the callback whenever the
+	buffer fills up and then the buffer starts again.
+*/
+typedef struct zloc_trace_buffer {
+	zloc_trace_event *events;
+	zloc_size capacity;
+	zloc_size start;
+	zloc_size count;
+	zloc_size dropped;			//Events that were overwritten before they could be read
+	zloc_trace_flush_callback flush_callback;
+	void *user_data;
+	#if defined(ZLOC_THREAD_SAFE)
+	volatile zloc_thread_access access;
+	#endif
+} zloc_trace_buffer;
+
+//Written at the start of a trace file by zloc_WriteTraceFileHeader, the events follow straight after
+typedef struct zloc_trace_file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t event_size;
+	uint64_t minimum_allocation_size;
+	uint32_t max_size_index;
+	uint32_t reserved;
+} zloc_trace_file_header;
+
+#define ZLOC_TRACE_FILE_MAGIC "ZLOCTRCE"
+#define ZLOC_TRACE_FILE_VERSION 1
+#endif
+
+#ifdef ZLOC_ENABLE_SAMPLING
+//All the sampled allocations that came from the same call stack
+typedef struct zloc_sample_callsite {
+	void *frames[ZLOC_SAMPLE_MAX_FRAMES];	//Return addresses, innermost first
+	uint64_t hash;
+	zloc_size depth;
+	zloc_size samples;
+	zloc_size sampled_bytes;				//Total size of the allocations that were sampled
+	zloc_size estimated_bytes;				//Estimate of everything allocated from here, sampled or not
+} zloc_sample_callsite;
+
+/*
+	Roughly one in every sample_rate bytes allocated gets a backtrace taken and added to a fixed size hash table of
+	callsites. When the table is full, samples from new callsites are dropped and counted.
+*/
+typedef struct zloc_sampler {
+	zloc_sample_callsite callsites[ZLOC_SAMPLE_CALLSITES];
+	zloc_size callsite_count;
+	zloc_size sample_rate;
+	zloc_size samples;
+	zloc_size dropped;
+	uint64_t random_state;
+	#if defined(ZLOC_THREAD_SAFE)
+	volatile zloc_thread_access access;
+	#endif
+} zloc_sampler;
+#endif
+
+//Which free block zloc hands out first when there's more then one in a size class
+typedef enum zloc_pool_policy {
+	zloc_pool_policy_most_recent,			//The block freed most recently, the default
+	zloc_pool_policy_lowest_address,		//The block at the lowest address, so live data stays in the lowest pools
+} zloc_pool_policy;
+
+//What zloc_VerifyStep found
+typedef enum zloc_verify_result {
+	zloc_verify_in_progress,				//Everything checked so far is fine, there's more of the pool to go
+	zloc_verify_pass_complete,				//Reached the end of the pool, the next step starts from the beginning again
+	zloc_verify_misaligned_size,			//A block size isn't a multiple of zloc__MEMORY_ALIGNMENT
+	zloc_verify_broken_link,				//The next block's prev_physical_block doesn't point back at the block
+	zloc_verify_boundary_tag_mismatch,		//The next block's PREV_BLOCK_IS_FREE flag doesn't match whether the block is free
+	zloc_verify_adjacent_free_blocks,		//Two free blocks next to each other that should have been merged
+	zloc_verify_bad_first_block,			//The first block in the pool says the block before it is free
+	zloc_verify_bad_sentinel,				//The block at the end of the pool isn't marked as used
+	zloc_verify_bad_checksum,				//A header checksum doesn't match (ZLOC_ENABLE_HEADER_CHECKSUMS)
+} zloc_verify_result;
+
+/*
+	Keeps track of where zloc_VerifyStep got to in a pool. The allocator moves the cursor along if the block it's on
+	gets merged into the one before it so that it's always safe to carry on from where it left off.
+*/
+typedef struct zloc_verify_cursor {
+	const zloc_pool *pool;
+	zloc_header *block;				//The next block to check
+	zloc_header *bad_block;			//The block that failed the last check, if any
+	zloc_size blocks_checked;		//Blocks checked so far in this pass
+	zloc_size passes;				//Number of times the whole pool has been checked
+} zloc_verify_cursor;
+
 typedef struct zloc_allocator {
-	/*	This is basically a terminator block that free blocks can point to if they're at the end
-		of a free list. */
-	zloc_header null_block;
 	#if defined(ZLOC_THREAD_SAFE)
-	/* Multithreading protection*/
+	/*	Multithreading protection. The lock has a cache line to itself so that threads waiting on it don't keep pulling
+		away the line that the thread holding it is writing the bitmaps and stats to. */
 	volatile zloc_thread_access access;
+	char access_padding[ZLOC_CACHE_LINE_SIZE - sizeof(zloc_thread_access)];
 	#endif
-	void *remote_user_data;
+	/*	Here we store all of the free block data. first_level_bitmap is either a 32bit int
+	or 64bit depending on whether zloc__64BIT is set. Second_level_bitmaps are an array of 32bit
+	ints. segregated_lists is a two level array pointing to free blocks or null_block if the list
+	is empty. The bitmaps and everything that's read on every allocate and free come first so that they
+	share as few cache lines as possible. */
+	zloc_fl_bitmap first_level_bitmap;
+	zloc_sl_bitmap second_level_bitmaps[zloc__FIRST_LEVEL_INDEX_COUNT];
 	zloc_size(*get_block_size_callback)(const zloc_header* block);
+	zloc_size minimum_allocation_size;
+	zloc_size block_extension_size;
+	zloc_pool_policy pool_policy;
+	zloc_verify_cursor *verify_cursor;
+	#ifdef ZLOC_ENABLE_TRACING
+	zloc_trace_buffer *trace;
+	#endif
+	#ifdef ZLOC_ENABLE_SAMPLING
+	zloc_sampler *sampler;
+	zloc_size bytes_until_sample;
+	#endif
+	#ifdef ZLOC_ENABLE_GUARD_PAGES
+	//Route zloc_Allocate, zloc_AllocateAligned, zloc_Reallocate and zloc_Free through the guarded versions
+	zloc_bool guard_pages;
+	#endif
+	zloc_allocation_stats_t stats;
+	/*	This is basically a terminator block that free blocks can point to if they're at the end
+		of a free list. */
+	zloc_header null_block;
+	zloc_header *segregated_lists[zloc__FIRST_LEVEL_INDEX_COUNT][zloc__SECOND_LEVEL_INDEX_COUNT];
+	//Total size of the free blocks in each segregated list, kept up to date on push/pop/remove
+	zloc_size free_list_bytes[zloc__FIRST_LEVEL_INDEX_COUNT][zloc__SECOND_LEVEL_INDEX_COUNT];
+	//Remote memory callbacks and user data, these only do anything for remote allocators
+	void *remote_user_data;
 	void(*merge_next_callback)(void *remote_user_data, zloc_header* block, zloc_header *next_block);
 	void(*merge_prev_callback)(void *remote_user_data, zloc_header* prev_block, zloc_header *block);
 	void(*split_block_callback)(void *remote_user_data, zloc_header* block, zloc_header* trimmed_block, zloc_size remote_size);
 	void(*add_pool_callback)(void *remote_user_data, void* block_extension);
 	void(*unable_to_reallocate_callback)(void *remote_user_data, zloc_header *block, zloc_header *new_block);
-	zloc_size block_extension_size;
+	void(*move_block_callback)(void *remote_user_data, zloc_header *block, zloc_header *new_block);
 	void *user_data;
-	zloc_size minimum_allocation_size;
 	zloc_size allocated_size;
-	/*	Here we store all of the free block data. first_level_bitmap is either a 32bit int
-	or 64bit depending on whether zloc__64BIT is set. Second_level_bitmaps are an array of 32bit
-	ints. segregated_lists is a two level array pointing to free blocks or null_block if the list
-	is empty. */
-	zloc_fl_bitmap first_level_bitmap;
-	zloc_sl_bitmap second_level_bitmaps[zloc__FIRST_LEVEL_INDEX_COUNT];
-	zloc_header *segregated_lists[zloc__FIRST_LEVEL_INDEX_COUNT][zloc__SECOND_LEVEL_INDEX_COUNT];
-	zloc_allocation_stats_t stats;
+	#ifdef ZLOC_ENABLE_CLASS_STATS
+	zloc_class_stats class_stats[zloc__FIRST_LEVEL_INDEX_COUNT][zloc__SECOND_LEVEL_INDEX_COUNT];
+	#endif
+	#ifdef ZLOC_ENABLE_TAGGING
+	//Total size of the used blocks with each tag and the most each tag is allowed to have in use (0 for no limit)
+	zloc_size tag_live_bytes[ZLOC_MAX_TAGS];
+	zloc_size tag_budgets[ZLOC_MAX_TAGS];
+	zloc_tag_over_budget_callback tag_over_budget_callback;
+	void *tag_user_data;
+	#endif
+	#ifdef ZLOC_ENABLE_QUARANTINE
+	//Freed blocks waiting to be really freed, oldest first, linked through the first pointer in each allocation
+	zloc_header *quarantine_head;
+	zloc_header *quarantine_tail;
+	zloc_size quarantine_bytes;
+	zloc_size quarantine_size;		//The most bytes that can be held in quarantine, 0 to switch it off
+	zloc_use_after_free_callback use_after_free_callback;
+	void *quarantine_user_data;
+	#endif
 } zloc_allocator;
+#if defined(ZLOC_THREAD_SAFE)
+zloc__static_assert(offsetof(zloc_allocator, first_level_bitmap) >= ZLOC_CACHE_LINE_SIZE);
+#endif
+
+/*
+	A pool in a zloc_pool_registry. Pools are kept in a list in address order so that pools sharing a granule can be
+	told apart.
+*/
+typedef struct zloc_registered_pool {
+	struct zloc_registered_pool *next;
+	struct zloc_registered_pool *prev;
+	zloc_allocator *allocator;
+	zloc_pool *pool;
+	zloc_size start;
+	zloc_size end;
+} zloc_registered_pool;
+
+//Each granule of the address space points at the lowest registered pool that overlaps it
+typedef struct zloc__registry_leaf {
+	zloc_registered_pool *pools[1 << ZLOC_REGISTRY_NODE_BITS];
+} zloc__registry_leaf;
+
+typedef struct zloc__registry_node {
+	zloc__registry_leaf *leaves[1 << ZLOC_REGISTRY_NODE_BITS];
+} zloc__registry_node;
+
+/*
+	Finds the pool and allocator that an allocation came from in constant time by looking up the allocation's address
+	in a radix tree, so there's nothing extra stored in the blocks. Nodes and pool records are carved out of memory that
+	you pass to zloc_InitialisePoolRegistry.
+*/
+typedef struct zloc_pool_registry {
+	zloc__registry_node *root[1 << zloc__REGISTRY_ROOT_BITS];
+	zloc_registered_pool *first;				//Lowest pool
+	zloc_registered_pool *free_records;			//Records of unregistered pools, ready to be reused
+	char *memory;
+	zloc_size memory_size;
+	zloc_size memory_used;
+	zloc_size pool_count;
+	#if defined(ZLOC_THREAD_SAFE)
+	//Only taken when registering and unregistering, lookups don't lock
+	volatile zloc_thread_access access;
+	#endif
+} zloc_pool_registry;
+
+#ifdef ZLOC_ENABLE_NUMA
+#ifndef ZLOC_NUMA_MAX_NODES
+#define ZLOC_NUMA_MAX_NODES 8
+#endif
+#ifndef ZLOC_NUMA_MAX_POOLS
+#define ZLOC_NUMA_MAX_POOLS 16
+#endif
+//Define ZLOC_NUMA_CURRENT_NODE() to decide which node a thread counts as being on yourself
+#ifndef ZLOC_NUMA_CURRENT_NODE
+#define ZLOC_NUMA_CURRENT_NODE() zloc_CurrentNumaNode()
+#endif
+
+typedef struct zloc_numa_pool {
+	void *memory;
+	zloc_size size;
+	zloc_bool mapped;			//Mapped by zloc_CreateNumaPool so zloc_ReleaseNumaPools unmaps it again
+	zloc_bool bound;			//The OS agreed to keep the pages on the node
+} zloc_numa_pool;
+
+/*
+	Each node has its own allocator which lives at the start of the first pool added to the node. The allocation
+	counts are kept against the node that served the allocation.
+*/
+typedef struct zloc_numa_node {
+	zloc_allocator *allocator;
+	zloc_numa_pool pools[ZLOC_NUMA_MAX_POOLS];
+	zloc_size pool_count;
+	zloc_size local_allocations;	//Allocations for threads running on this node
+	zloc_size remote_allocations;	//Allocations for threads on other nodes after their own node ran out
+} zloc_numa_node;
+
+typedef struct zloc_numa_stats {
+	zloc_size pools;
+	zloc_size bound_pools;
+	zloc_size capacity;
+	zloc_size free;
+	zloc_size blocks_in_use;
+	zloc_size local_allocations;
+	zloc_size remote_allocations;
+} zloc_numa_stats;
+
+typedef struct zloc_numa_allocator {
+	zloc_numa_node nodes[ZLOC_NUMA_MAX_NODES];
+	zloc_uint node_count;
+	zloc_pool_registry *registry;		//Set with zloc_SetNumaPoolRegistry to find the node of an allocation in O(1)
+	#if defined(ZLOC_THREAD_SAFE)
+	//Only taken when adding pools, allocations just lock the allocator of the node they come from
+	volatile zloc_thread_access access;
+	#endif
+} zloc_numa_allocator;
+#endif
 
 /*
 A minimal remote header block. You can define your own header to store additional information but it must include
@@ -231,6 +633,75 @@ typedef struct zloc_remote_header {
 	zloc_size memory_offset;
 } zloc_remote_header;
 
+/*
+	Filled in by zloc_GetFragmentationReport. external_fragmentation is 1 - largest_free_block / total_free, so 0 means
+	all the free memory is in one block and the closer it gets to 1 the more the free memory is split into small blocks
+	that can't satisfy bigger allocations.
+*/
+typedef struct zloc_fragmentation_report {
+	zloc_size total_free;
+	zloc_size largest_free_block;
+	int free_blocks;
+	float external_fragmentation;
+	zloc_size free_bytes_by_class[zloc__FIRST_LEVEL_INDEX_COUNT][zloc__SECOND_LEVEL_INDEX_COUNT];
+} zloc_fragmentation_report;
+
+/*
+	Heap dump file layout written by zloc_WriteHeapDump: a zloc_heap_dump_header followed by block_count
+	zloc_heap_dump_block records in physical order. All fields are fixed size and little endian on the platforms zloc
+	runs on, so dumps can be read by any build.
+*/
+#define ZLOC_HEAP_DUMP_MAGIC "ZLOCHEAP"
+#define ZLOC_HEAP_DUMP_VERSION 1
+
+typedef enum zloc_heap_dump_flags {
+	zloc_heap_dump_remote = 1 << 0,			//Header flag: offsets and sizes are remote memory_offset/size
+	zloc_heap_dump_block_used = 1 << 0,		//Block flag: the block is in use
+} zloc_heap_dump_flags;
+
+typedef struct zloc_heap_dump_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t block_count;
+	uint64_t pool_size;				//End of the last block, so every block fits in 0 - pool_size
+	uint64_t block_overhead;		//Header bytes in front of each block, 0 for remote pools
+	uint64_t minimum_allocation_size;
+} zloc_heap_dump_header;
+
+typedef struct zloc_heap_dump_block {
+	uint64_t offset;				//From the start of the pool memory to the start of the block's usable memory
+	uint64_t size;
+	uint32_t flags;
+	uint32_t tag;					//Allocation tag with ZLOC_ENABLE_TAGGING, otherwise 0
+} zloc_heap_dump_block;
+
+//All the live allocations with the same block size and tag
+typedef struct zloc_leak_group {
+	zloc_size block_size;
+	zloc_uint tag;					//Always 0 without ZLOC_ENABLE_TAGGING
+	zloc_size count;
+	zloc_size total_bytes;
+} zloc_leak_group;
+
+typedef void(*zloc_leak_callback)(void *user_data, void *allocation, zloc_size size, zloc_uint tag);
+
+/*
+	Filled in by zloc_CreateLeakReport. Set groups and max_groups to the array the groups should go in, and optionally a
+	callback to be told about every live allocation. Allocations that don't fit in the groups are still counted.
+*/
+typedef struct zloc_leak_report {
+	zloc_leak_group *groups;		//Sorted by total_bytes, largest first
+	zloc_size max_groups;
+	zloc_size group_count;
+	zloc_size allocations;
+	zloc_size bytes;
+	zloc_size ungrouped_allocations;
+	zloc_size ungrouped_bytes;
+	zloc_leak_callback callback;
+	void *user_data;
+} zloc_leak_report;
+
 typedef struct zloc_pool_stats_t {
 	int used_blocks;
 	int free_blocks;
@@ -332,14 +803,106 @@ ZLOC_API zloc_pool *zloc_AddPool(zloc_allocator *allocator, void *memory, zloc_s
 ZLOC_API zloc_size zloc_AllocatorSize(void);
 ZLOC_API zloc_pool *zloc_GetPool(zloc_allocator *allocator);
 ZLOC_API void *zloc_Allocate(zloc_allocator *allocator, zloc_size size);
+ZLOC_API void *zloc_AllocateSizeReturning(zloc_allocator *allocator, zloc_size size, zloc_size *usable_size);
+ZLOC_API zloc_size zloc_UsableSize(const void *allocation);
 ZLOC_API void *zloc_Reallocate(zloc_allocator *allocator, void *ptr, zloc_size size);
+ZLOC_API void *zloc_AllocateZeroed(zloc_allocator *allocator, zloc_size size);
+ZLOC_API void *zloc_ReallocateZeroed(zloc_allocator *allocator, void *ptr, zloc_size size);
+ZLOC_API void *zloc_Shrink(zloc_allocator *allocator, void *ptr, zloc_size size);
 ZLOC_API void *zloc_AllocateAligned(zloc_allocator *allocator, zloc_size size, zloc_size alignment);
 ZLOC_API int zloc_Free(zloc_allocator *allocator, void *allocation);
 ZLOC_API void* zloc_PromoteLinearBlock(zloc_allocator *allocator, void* linear_alloc_mem, zloc_size used_size);
 ZLOC_API zloc_bool zloc_RemovePool(zloc_allocator *allocator, zloc_pool *pool);
 ZLOC_API void zloc_SetMinimumAllocationSize(zloc_allocator *allocator, zloc_size size);
+ZLOC_API void zloc_SetPoolPolicy(zloc_allocator *allocator, zloc_pool_policy policy);
 ZLOC_API zloc_pool_stats_t zloc_CreateMemorySnapshot(const zloc_pool *pool);
 ZLOC_API void zloc_VerifyPool(zloc_allocator *allocator, const zloc_pool *pool);
+ZLOC_API void zloc_InitialiseVerifyCursor(zloc_allocator *allocator, zloc_verify_cursor *cursor, const zloc_pool *pool);
+ZLOC_API zloc_verify_result zloc_VerifyStep(zloc_allocator *allocator, zloc_verify_cursor *cursor, zloc_size block_budget);
+ZLOC_API void zloc_ReleaseVerifyCursor(zloc_allocator *allocator, zloc_verify_cursor *cursor);
+ZLOC_API void zloc_GetFragmentationReport(zloc_allocator *allocator, zloc_fragmentation_report *report);
+ZLOC_API zloc_bool zloc_WriteHeapDump(zloc_allocator *allocator, const zloc_pool *pool, FILE *file);
+ZLOC_API void zloc_CreateLeakReport(zloc_allocator *allocator, zloc_pool **pools, zloc_size pool_count, zloc_leak_report *report);
+
+//Zero tracking
+#ifdef ZLOC_ENABLE_ZERO_TRACKING
+ZLOC_API zloc_pool *zloc_AddZeroedPool(zloc_allocator *allocator, void *memory, zloc_size size);
+ZLOC_API zloc_size zloc_PurgeFreeMemory(zloc_allocator *allocator);
+#endif
+
+//Size class statistics
+#ifdef ZLOC_ENABLE_CLASS_STATS
+ZLOC_API zloc_class_stats zloc_GetClassStats(const zloc_allocator *allocator, zloc_index fli, zloc_index sli);
+ZLOC_API void zloc_GetAllClassStats(const zloc_allocator *allocator, zloc_class_stats stats[zloc__FIRST_LEVEL_INDEX_COUNT][zloc__SECOND_LEVEL_INDEX_COUNT]);
+ZLOC_API zloc_size zloc_ClassMinimumSize(zloc_index fli, zloc_index sli);
+#endif
+
+//Allocation tags and budgets
+#ifdef ZLOC_ENABLE_TAGGING
+ZLOC_API void *zloc_AllocateTagged(zloc_allocator *allocator, zloc_size size, zloc_uint tag);
+ZLOC_API zloc_uint zloc_GetAllocationTag(const void *allocation);
+ZLOC_API zloc_size zloc_GetTagLiveBytes(const zloc_allocator *allocator, zloc_uint tag);
+ZLOC_API void zloc_SetTagBudget(zloc_allocator *allocator, zloc_uint tag, zloc_size budget);
+ZLOC_API void zloc_SetTagOverBudgetCallback(zloc_allocator *allocator, zloc_tag_over_budget_callback callback, void *user_data);
+#endif
+
+//Tracing
+#ifdef ZLOC_ENABLE_TRACING
+ZLOC_API void zloc_InitialiseTraceBuffer(zloc_trace_buffer *trace, zloc_trace_event *events, zloc_size capacity);
+ZLOC_API void zloc_SetTraceFlushCallback(zloc_trace_buffer *trace, zloc_trace_flush_callback callback, void *user_data);
+ZLOC_API void zloc_SetTraceBuffer(zloc_allocator *allocator, zloc_trace_buffer *trace);
+ZLOC_API zloc_size zloc_GetTraceEvents(zloc_trace_buffer *trace, zloc_trace_event *events, zloc_size max_events);
+ZLOC_API void zloc_FlushTraceBuffer(zloc_trace_buffer *trace);
+ZLOC_API zloc_bool zloc_WriteTraceFileHeader(FILE *file, const zloc_allocator *allocator);
+ZLOC_API void zloc_TraceFileFlushCallback(void *file, const zloc_trace_event *events, zloc_size count);
+#endif
+
+//Guard pages
+#ifdef ZLOC_ENABLE_GUARD_PAGES
+ZLOC_API void *zloc_AllocateGuarded(zloc_allocator *allocator, zloc_size size, zloc_size alignment);
+ZLOC_API int zloc_FreeGuarded(zloc_allocator *allocator, void *allocation);
+ZLOC_API void zloc_SetGuardPages(zloc_allocator *allocator, zloc_bool enabled);
+#endif
+
+//Quarantine
+#ifdef ZLOC_ENABLE_QUARANTINE
+ZLOC_API void zloc_SetQuarantineSize(zloc_allocator *allocator, zloc_size bytes);
+ZLOC_API void zloc_FlushQuarantine(zloc_allocator *allocator);
+ZLOC_API void zloc_SetUseAfterFreeCallback(zloc_allocator *allocator, zloc_use_after_free_callback callback, void *user_data);
+#endif
+
+//Sampling profiler
+#ifdef ZLOC_ENABLE_SAMPLING
+ZLOC_API void zloc_InitialiseSampler(zloc_sampler *sampler, zloc_size sample_rate);
+ZLOC_API void zloc_SetSampler(zloc_allocator *allocator, zloc_sampler *sampler);
+ZLOC_API void zloc_ResetSampler(zloc_sampler *sampler);
+ZLOC_API zloc_size zloc_GetSampledCallsites(zloc_sampler *sampler, zloc_sample_callsite *callsites, zloc_size max_callsites);
+ZLOC_API zloc_bool zloc_WriteFoldedStacks(zloc_sampler *sampler, FILE *file);
+#endif
+
+//Pool registry
+ZLOC_API void zloc_InitialisePoolRegistry(zloc_pool_registry *registry, void *memory, zloc_size size);
+ZLOC_API zloc_bool zloc_RegisterPool(zloc_pool_registry *registry, zloc_allocator *allocator, zloc_pool *pool, zloc_size size);
+ZLOC_API zloc_bool zloc_UnregisterPool(zloc_pool_registry *registry, zloc_pool *pool);
+ZLOC_API zloc_pool *zloc_LookupPool(const zloc_pool_registry *registry, const void *allocation, zloc_allocator **allocator);
+ZLOC_API int zloc_RegistryFree(zloc_pool_registry *registry, void *allocation);
+
+//NUMA
+#ifdef ZLOC_ENABLE_NUMA
+ZLOC_API zloc_uint zloc_NumaNodeCount(void);
+ZLOC_API zloc_uint zloc_CurrentNumaNode(void);
+ZLOC_API void zloc_InitialiseNumaAllocator(zloc_numa_allocator *numa, zloc_uint node_count);
+ZLOC_API zloc_bool zloc_AddNumaPool(zloc_numa_allocator *numa, zloc_uint node, void *memory, zloc_size size);
+ZLOC_API void *zloc_CreateNumaPool(zloc_numa_allocator *numa, zloc_uint node, zloc_size size);
+ZLOC_API void zloc_ReleaseNumaPools(zloc_numa_allocator *numa);
+ZLOC_API void *zloc_NumaAllocate(zloc_numa_allocator *numa, zloc_size size);
+ZLOC_API void *zloc_NumaAllocateOnNode(zloc_numa_allocator *numa, zloc_uint node, zloc_size size);
+ZLOC_API void *zloc_NumaReallocate(zloc_numa_allocator *numa, void *allocation, zloc_size size);
+ZLOC_API int zloc_NumaFree(zloc_numa_allocator *numa, void *allocation);
+ZLOC_API int zloc_NumaNodeOf(const zloc_numa_allocator *numa, const void *allocation);
+ZLOC_API void zloc_SetNumaPoolRegistry(zloc_numa_allocator *numa, zloc_pool_registry *registry);
+ZLOC_API zloc_numa_stats zloc_GetNumaNodeStats(zloc_numa_allocator *numa, zloc_uint node);
+#endif
 
 //Remote memory
 ZLOC_API zloc_allocator *zloc_InitialiseAllocatorForRemote(void *memory);
@@ -373,14 +936,15 @@ ZLOC_API zloc_size zloc_GetLinearAllocatorCapacity(zloc_linear_allocator_t *allo
 //Private inline functions, user doesn't need to call these
 
 static inline void zloc__map(zloc_size size, zloc_index *fli, zloc_index *sli) {
-	*fli = zloc__scan_reverse(size);
-	if (*fli <= zloc__SECOND_LEVEL_INDEX_LOG2) {
-		*fli = 0;
-		*sli = (int)size / (zloc__SMALLEST_CATEGORY / zloc__SECOND_LEVEL_INDEX_COUNT);
-		return;
-	}
-	size = size & ~(ZLOC_ONE << *fli);
-	*sli = (zloc_index)(size >> (*fli - zloc__SECOND_LEVEL_INDEX_LOG2)) % zloc__SECOND_LEVEL_INDEX_COUNT;
+	//Sizes below 1 << (zloc__SECOND_LEVEL_INDEX_LOG2 + 1) all go in first level 0 and are indexed by alignment, everything
+	//else is indexed by its top bit and the next zloc__SECOND_LEVEL_INDEX_LOG2 bits below it. Both are worked out and one
+	//is picked with a mask rather than a branch, because when sizes are mixed that branch goes either way on every call.
+	zloc_index top = zloc__scan_reverse(size | 1);
+	zloc_index large = -(zloc_index)(top > zloc__SECOND_LEVEL_INDEX_LOG2);
+	zloc_index small_sli = (zloc_index)(size >> MEMORY_ALIGNMENT_LOG2);
+	zloc_index large_sli = (zloc_index)(size >> ((top - zloc__SECOND_LEVEL_INDEX_LOG2) & large)) & (zloc__SECOND_LEVEL_INDEX_COUNT - 1);
+	*fli = top & large;
+	*sli = (large_sli & large) | (small_sli & ~large);
 }
 
 static inline void zloc__null_merge_callback(void *remote_user_data, zloc_header *block1, zloc_header *block2) { return; }
@@ -398,7 +962,7 @@ static inline zloc_index zloc__find_next_size_up(zloc_fl_bitmap map, zloc_uint s
 	return zloc__scan_forward(map);
 }
 
-static inline zloc_bool zloc__is_free_block(const zloc_header *block) {
+static inline zloc__no_sanitize zloc_bool zloc__is_free_block(const zloc_header *block) {
 	return block->size & zloc__BLOCK_IS_FREE;   
 	//If you're crashing here, then you're probably trying to free
 	//something that isn't a memory block. Maybe you should be
@@ -411,7 +975,7 @@ static inline zloc_bool zloc__is_free_block(const zloc_header *block) {
 //but the buffer pointer that was being written too was not updated after the resize for example.
 //For complementary coverage of the physical block chain (boundary tags, merge invariants, intact prev/next links),
 //see zloc_VerifyPool.
-static inline void zloc__verify_lists(zloc_allocator *allocator) {
+static inline zloc__no_sanitize void zloc__verify_lists(zloc_allocator *allocator) {
 	zloc_header *null_block = &allocator->null_block;
 	for (int fli = 0; fli != zloc__FIRST_LEVEL_INDEX_COUNT; ++fli) {
 		zloc_bool fl_set = (allocator->first_level_bitmap & (ZLOC_ONE << fli)) != 0;
@@ -464,11 +1028,11 @@ static inline zloc_bool zloc__has_free_block(const zloc_allocator *allocator, zl
 	return allocator->first_level_bitmap & (ZLOC_ONE << fli) && allocator->second_level_bitmaps[fli] & (1U << sli);
 }
 
-static inline zloc_bool zloc__is_used_block(const zloc_header *block) {
+static inline zloc__no_sanitize zloc_bool zloc__is_used_block(const zloc_header *block) {
 	return !(block->size & zloc__BLOCK_IS_FREE);
 }
 
-static inline zloc_bool zloc__prev_is_free_block(const zloc_header *block) {
+static inline zloc__no_sanitize zloc_bool zloc__prev_is_free_block(const zloc_header *block) {
 	return block->size & zloc__PREV_BLOCK_IS_FREE;
 }
 
@@ -503,8 +1067,8 @@ static inline zloc_size zloc__adjust_size(zloc_size size, zloc_size minimum_size
 	return zloc__Min(zloc__Max(zloc__align_size_up(size, alignment), minimum_size), zloc__MAXIMUM_BLOCK_SIZE);
 }
 
-static inline zloc_size zloc__block_size(const zloc_header *block) {
-	return block->size & ~(zloc__BLOCK_IS_FREE | zloc__PREV_BLOCK_IS_FREE);
+static inline zloc__no_sanitize zloc_size zloc__block_size(const zloc_header *block) {
+	return block->size & ~(zloc_size)zloc__BLOCK_FLAGS;
 }
 
 static inline zloc_header *zloc__block_from_allocation(const void *allocation) {
@@ -542,9 +1106,25 @@ static inline zloc_bool zloc__is_last_block_in_pool(const zloc_header *block) {
 //Write functions
 #if defined(ZLOC_THREAD_SAFE)
 
+//Let the core know it's spinning so it can ease off and give the other hyperthread a go
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define zloc__cpu_relax() _mm_pause()
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+#define zloc__cpu_relax() __builtin_ia32_pause()
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+#define zloc__cpu_relax() __asm__ __volatile__("yield")
+#else
+#define zloc__cpu_relax()
+#endif
+
+//Waiting threads only read the lock until it looks free rather then hammering it with compare and exchanges, which
+//would keep taking the cache line away from the thread holding the lock
 #define zloc__lock_thread_access(allocator)												\
-do { \
-} while (0 != zloc__compare_and_exchange(&allocator->access, 1, 0)); \
+while (0 != zloc__compare_and_exchange(&allocator->access, 1, 0)) { \
+	while (allocator->access) { \
+		zloc__cpu_relax(); \
+	} \
+} \
 ZLOC_ASSERT(allocator->access != 0);
 
 #define zloc__unlock_thread_access(allocator) allocator->access = 0;
@@ -555,97 +1135,360 @@ ZLOC_ASSERT(allocator->access != 0);
 #define zloc__unlock_thread_access(allocator)
 
 #endif
-void *zloc__allocate(zloc_allocator *allocator, zloc_size size, zloc_size remote_size);
+void *zloc__allocate(zloc_allocator *allocator, zloc_size size, zloc_size remote_size, zloc_uint tag, zloc_bool zeroed);
+
+#ifdef ZLOC_ENABLE_HEADER_CHECKSUMS
+#ifndef ZLOC_HEADER_CHECKSUM_KEY
+#define ZLOC_HEADER_CHECKSUM_KEY 0x5A4C4F43
+#endif
+//What to do when a block header has been written over. Define it yourself to log it or count it instead
+#ifndef ZLOC_HEADER_CORRUPTED
+#define ZLOC_HEADER_CORRUPTED(block) ZLOC_ASSERT(0 && "Block header checksum doesn't match, something has written over it")
+#endif
+#define zloc__CHECKSUM_MULTIPLIER ((zloc_size)0x9E3779B97F4A7C15ULL)
+
+/*
+	prev_physical_block is only part of the checksum while the previous block is free. That's the only time it's used
+	for anything and the first block in a pool doesn't have one at all (it's whatever is just before the pool memory).
+	When a block is freed the next block's prev_physical_block is checked before its flag is set.
+*/
+static inline zloc__no_sanitize zloc_size zloc__header_checksum(const zloc_header *block) {
+	zloc_size prev = (block->size & zloc__PREV_BLOCK_IS_FREE) ? (zloc_size)(uintptr_t)block->prev_physical_block : 0;
+	zloc_size hash = ((zloc_size)(uintptr_t)block ^ (zloc_size)ZLOC_HEADER_CHECKSUM_KEY) + block->size * zloc__CHECKSUM_MULTIPLIER;
+	hash ^= hash >> 15;
+	hash = (hash + prev) * zloc__CHECKSUM_MULTIPLIER;
+	return hash ^ (hash >> 13);
+}
+
+static inline zloc__no_sanitize void zloc__seal_header(zloc_header *block) {
+	block->checksum = zloc__header_checksum(block);
+}
+
+static inline zloc__no_sanitize zloc_bool zloc__header_is_intact(const zloc_header *block) {
+	if (block->checksum == zloc__header_checksum(block)) {
+		return 1;
+	}
+	ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: The header of the block at %p has been written over.\n", ZLOC_ERROR_NAME, (void*)block);
+	ZLOC_HEADER_CORRUPTED(block);
+	return 0;
+}
+#else
+#define zloc__seal_header(block)
+#define zloc__header_is_intact(block) 1
+#endif
 
-static inline void zloc__set_block_size(zloc_header *block, zloc_size size) {
+static inline zloc__no_sanitize void zloc__set_block_size(zloc_header *block, zloc_size size) {
 	zloc_size boundary_tag = block->size & (zloc__BLOCK_IS_FREE | zloc__PREV_BLOCK_IS_FREE);
 	block->size = size | boundary_tag;
+	zloc__seal_header(block);
 }
 
-static inline void zloc__set_prev_physical_block(zloc_header *block, zloc_header *prev_block) {
+static inline zloc__no_sanitize void zloc__set_prev_physical_block(zloc_header *block, zloc_header *prev_block) {
 	block->prev_physical_block = prev_block;
+	zloc__seal_header(block);
 }
 
-static inline void zloc__zero_block(zloc_header *block) {
+static inline zloc__no_sanitize void zloc__zero_block(zloc_header *block) {
 	block->prev_physical_block = 0;
 	block->size = 0;
 }
 
-static inline void zloc__mark_block_as_used(zloc_header *block) {
+static inline zloc__no_sanitize void zloc__mark_block_as_used(zloc_header *block) {
 	block->size &= ~zloc__BLOCK_IS_FREE;
+	zloc__seal_header(block);
 	zloc_header *next_block = zloc__next_physical_block(block);
 	next_block->size &= ~zloc__PREV_BLOCK_IS_FREE;
+	zloc__seal_header(next_block);
 }
 
-static inline void zloc__mark_block_as_free(zloc_header *block) {
+static inline zloc__no_sanitize void zloc__mark_block_as_free(zloc_header *block) {
 	block->size |= zloc__BLOCK_IS_FREE;
+	zloc__seal_header(block);
 	zloc_header *next_block = zloc__next_physical_block(block);
 	next_block->size |= zloc__PREV_BLOCK_IS_FREE;
+	zloc__seal_header(next_block);
 }
 
-static inline void zloc__block_set_used(zloc_header *block) {
+static inline zloc__no_sanitize void zloc__block_set_used(zloc_header *block) {
 	block->size &= ~zloc__BLOCK_IS_FREE;
+	zloc__seal_header(block);
 }
 
-static inline void zloc__block_set_free(zloc_header *block) {
+static inline zloc__no_sanitize void zloc__block_set_free(zloc_header *block) {
 	block->size |= zloc__BLOCK_IS_FREE;
+	zloc__seal_header(block);
+}
+
+#ifdef ZLOC_ENABLE_ZERO_TRACKING
+/*
+	A free block with the zero flag has nothing but zeros in it apart from its free list pointers. The flag only lives on
+	free blocks: it goes whenever a block's size is set (merging means the old header is in there now) and is taken off
+	by whoever gets the block from zloc__find_free_block. Splitting a zero block hands the flag to both halves.
+*/
+static inline zloc__no_sanitize zloc_size zloc__zero_flag(const zloc_header *block) {
+	return block->size & zloc__BLOCK_IS_ZERO;
+}
+
+static inline zloc__no_sanitize void zloc__set_zero_flag(zloc_header *block, zloc_size flag) {
+	block->size |= flag;
+	zloc__seal_header(block);
+}
+
+static inline zloc__no_sanitize zloc_bool zloc__take_zero_flag(zloc_header *block) {
+	zloc_size flag = zloc__zero_flag(block);
+	block->size &= ~(zloc_size)zloc__BLOCK_IS_ZERO;
+	zloc__seal_header(block);
+	return flag != 0;
+}
+#else
+#define zloc__zero_flag(block) 0
+#define zloc__set_zero_flag(block, flag) (void)(flag)
+#define zloc__take_zero_flag(block) 0
+#endif
+
+//Zero part of an allocation, clamped to the size of the block
+static inline void zloc__zero_allocation(zloc_header *block, zloc_size from, zloc_size to) {
+	to = zloc__Min(to, zloc__block_size(block));
+	if (from < to) {
+		memset((char*)zloc__block_user_ptr(block) + from, 0, to - from);
+	}
 }
 
-static inline void zloc__block_set_prev_used(zloc_header *block) {
+static inline zloc__no_sanitize void zloc__block_set_prev_used(zloc_header *block) {
 	block->size &= ~zloc__PREV_BLOCK_IS_FREE;
+	zloc__seal_header(block);
 }
 
-static inline void zloc__block_set_prev_free(zloc_header *block) {
+static inline zloc__no_sanitize void zloc__block_set_prev_free(zloc_header *block) {
 	block->size |= zloc__PREV_BLOCK_IS_FREE;
+	zloc__seal_header(block);
 }
 
+#if defined(ZLOC_ENABLE_CLASS_STATS) || defined(ZLOC_ENABLE_TAGGING)
 /*
-	Push a block onto the segregated list of free blocks. Called when zloc_Free is called. Generally blocks are
-	merged if possible before this is called
+	Class stats and tag counters are only ever written with the allocator lock held, so a relaxed load and store is
+	enough for the counters to be read from another thread without a lock and without tearing. No read-modify-write
+	needed.
 */
-static inline void zloc__push_block(zloc_allocator *allocator, zloc_header *block) {
-	zloc_index fli;
-	zloc_index sli;
-	//Get the size class of the block
-	zloc__map(zloc__do_size_class_callback(block), &fli, &sli);
-	zloc_header *current_block_in_free_list = allocator->segregated_lists[fli][sli];
-	//If you hit this assert then it's likely that at somepoint in your code you're trying to free an allocation
-	//that was already freed or trying to free something that wasn't allocated by the allocator.
-	ZLOC_ASSERT(block != current_block_in_free_list);
-	//Insert the block into the list by updating the next and prev free blocks of
-	//this and the current block in the free list. The current block in the free
-	//list may well be the null_block in the allocator so this just means that this
-	//block will be added as the first block in this class of free blocks.
-	block->next_free_block = current_block_in_free_list;
-	block->prev_free_block = &allocator->null_block;
-	current_block_in_free_list->prev_free_block = block;
-
-	allocator->segregated_lists[fli][sli] = block;
-	//Flag the bitmaps to mark that this size class now contains a free block
-	allocator->first_level_bitmap |= ZLOC_ONE << fli;
-	allocator->second_level_bitmaps[fli] |= 1U << sli;
-	if (allocator->first_level_bitmap & (ZLOC_ONE << fli)) {
-		ZLOC_ASSERT(allocator->second_level_bitmaps[fli] > 0);
-	}
-	zloc__mark_block_as_free(block);
-	allocator->stats.free += zloc__block_size(block);
-	allocator->stats.free_blocks++;
-	allocator->stats.blocks_in_use--;
-	#ifdef ZLOC_EXTRA_DEBUGGING
-	zloc__verify_lists(allocator);
-	#endif
+#if defined(ZLOC_THREAD_SAFE) && (defined(__GNUC__) || defined(__clang__))
+#define zloc__stat_read(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+#define zloc__stat_add(counter, value) __atomic_store_n(&(counter), __atomic_load_n(&(counter), __ATOMIC_RELAXED) + (value), __ATOMIC_RELAXED)
+#elif defined(ZLOC_THREAD_SAFE)
+#define zloc__stat_read(counter) (*(volatile zloc_size*)&(counter))
+#define zloc__stat_add(counter, value) (*(volatile zloc_size*)&(counter) = (counter) + (value))
+#else
+#define zloc__stat_read(counter) (counter)
+#define zloc__stat_add(counter, value) ((counter) += (value))
+#endif
+#endif
+
+#ifdef ZLOC_ENABLE_CLASS_STATS
+static inline zloc_class_stats *zloc__class_stats_for_size(zloc_allocator *allocator, zloc_size size) {
+	zloc_index fli, sli;
+	zloc__map(size, &fli, &sli);
+	return &allocator->class_stats[fli][sli];
+}
+
+static inline void zloc__count_allocation(zloc_allocator *allocator, const zloc_header *block) {
+	zloc_size size = zloc__do_size_class_callback(block);
+	zloc_class_stats *stats = zloc__class_stats_for_size(allocator, size);
+	zloc__stat_add(stats->allocations, 1);
+	zloc__stat_add(stats->live_bytes, size);
+}
+
+static inline void zloc__count_free(zloc_allocator *allocator, const zloc_header *block) {
+	zloc_size size = zloc__do_size_class_callback(block);
+	zloc_class_stats *stats = zloc__class_stats_for_size(allocator, size);
+	zloc__stat_add(stats->frees, 1);
+	zloc__stat_add(stats->live_bytes, (zloc_size)0 - size);
+}
+
+//A used block changed size in place, move its live bytes over to the new class
+static inline void zloc__count_resize(zloc_allocator *allocator, zloc_size old_size, const zloc_header *block) {
+	zloc_size size = zloc__do_size_class_callback(block);
+	zloc_class_stats *stats = zloc__class_stats_for_size(allocator, old_size);
+	zloc__stat_add(stats->live_bytes, (zloc_size)0 - old_size);
+	stats = zloc__class_stats_for_size(allocator, size);
+	zloc__stat_add(stats->live_bytes, size);
+}
+
+static inline void zloc__count_split(zloc_allocator *allocator, const zloc_header *block) {
+	zloc__stat_add(zloc__class_stats_for_size(allocator, zloc__do_size_class_callback(block))->splits, 1);
+}
+
+static inline void zloc__count_merge(zloc_allocator *allocator, const zloc_header *block) {
+	zloc__stat_add(zloc__class_stats_for_size(allocator, zloc__do_size_class_callback(block))->merges, 1);
+}
+
+static inline void zloc__count_escalation(zloc_allocator *allocator, zloc_index fli, zloc_index sli) {
+	zloc__stat_add(allocator->class_stats[fli][sli].escalations, 1);
+}
+#else
+#define zloc__count_allocation(allocator, block)
+#define zloc__count_free(allocator, block)
+#define zloc__count_resize(allocator, old_size, block)
+#define zloc__count_split(allocator, block)
+#define zloc__count_merge(allocator, block)
+#define zloc__count_escalation(allocator, fli, sli)
+#endif
+
+#ifdef ZLOC_ENABLE_TAGGING
+static inline zloc__no_sanitize zloc_uint zloc__block_tag(const zloc_header *block) {
+	return (zloc_uint)block->tag;
 }
 
 /*
-	Remove a block from the segregated list in the allocator and return it. If there is a next free block in the size class
-	then move it down the list, otherwise unflag the bitmaps as necessary. This is only called when we're trying to allocate
-	some memory with zloc_Allocate and we've determined that there's a suitable free block in segregated_lists.
+	Check that a tag can take another size bytes without going over its budget. If it would go over then the over
+	budget callback gets to decide, without one the allocation fails.
 */
-static inline zloc_header *zloc__pop_block(zloc_allocator *allocator, zloc_index fli, zloc_index sli) {
-	zloc_header *block = allocator->segregated_lists[fli][sli];
+static inline zloc_bool zloc__tag_has_room(zloc_allocator *allocator, zloc_uint tag, zloc_size size) {
+	ZLOC_ASSERT(tag < ZLOC_MAX_TAGS);	//Tag is out of range, increase ZLOC_MAX_TAGS
+	zloc_size budget = allocator->tag_budgets[tag];
+	zloc_size live_bytes = allocator->tag_live_bytes[tag];
+	if (!budget || live_bytes + size <= budget) {
+		return 1;
+	}
+	return allocator->tag_over_budget_callback ? allocator->tag_over_budget_callback(allocator->tag_user_data, tag, live_bytes, size) : 0;
+}
 
-	//If the block in the segregated list is actually the null_block then something went very wrong.
-	//Somehow the segregated lists had the end block assigned but the first or second level bitmaps
+static inline zloc__no_sanitize void zloc__tag_allocation(zloc_allocator *allocator, zloc_header *block, zloc_uint tag) {
+	block->tag = tag;
+	zloc__stat_add(allocator->tag_live_bytes[tag], zloc__do_size_class_callback(block));
+}
+
+static inline zloc__no_sanitize void zloc__tag_free(zloc_allocator *allocator, const zloc_header *block) {
+	zloc__stat_add(allocator->tag_live_bytes[block->tag], (zloc_size)0 - zloc__do_size_class_callback(block));
+}
+
+static inline zloc__no_sanitize void zloc__tag_resize(zloc_allocator *allocator, zloc_size old_size, const zloc_header *block) {
+	zloc__stat_add(allocator->tag_live_bytes[block->tag], zloc__do_size_class_callback(block) - old_size);
+}
+#else
+#define zloc__block_tag(block) 0
+//The tag is still used so that the allocation functions don't end up with an unused parameter
+#define zloc__tag_has_room(allocator, tag, size) ((void)(tag), 1)
+#define zloc__tag_allocation(allocator, block, tag)
+#define zloc__tag_free(allocator, block)
+#define zloc__tag_resize(allocator, old_size, block)
+#endif
+
+#ifdef ZLOC_ENABLE_MEMORY_POISONING
+/*
+	Keep the sanitizer's view of the pool up to date: only the user area of used blocks can be touched. Free blocks
+	are poisoned, and so is the start of the next block's header after an allocation so that even a one byte overrun
+	is caught. Valgrind can't be told to ignore the allocator's own reads and writes so there the headers and free list
+	pointers are left alone and only the rest of each free block is poisoned. Remote memory isn't poisoned at all.
+*/
+static inline zloc_bool zloc__poisons_blocks(const zloc_allocator *allocator) {
+	return allocator->get_block_size_callback == zloc__block_size;
+}
+
+static inline void zloc__poison_free_block(zloc_allocator *allocator, zloc_header *block) {
+	if (!zloc__poisons_blocks(allocator)) return;
+	char *allocation = (char*)zloc__block_user_ptr(block);
+	#if defined(zloc__ASAN)
+	char *start = (char*)block + zloc__POINTER_SIZE;
+	zloc__poison_memory(start, allocation + zloc__block_size(block) + zloc__POINTER_SIZE - start);
+	#else
+	zloc__poison_memory(allocation + zloc__POINTER_SIZE * 2, zloc__block_size(block) - zloc__POINTER_SIZE * 2);
+	#endif
+}
+
+static inline void zloc__unpoison_allocation(zloc_allocator *allocator, zloc_header *block) {
+	if (!zloc__poisons_blocks(allocator)) return;
+	char *allocation = (char*)zloc__block_user_ptr(block);
+	zloc__unpoison_memory(allocation, zloc__block_size(block));
+	#if defined(zloc__ASAN)
+	zloc__poison_memory(allocation + zloc__block_size(block), zloc__POINTER_SIZE);
+	#endif
+}
+
+//Make room to write a new block header into memory that might be poisoned
+static inline void zloc__unpoison_header(zloc_allocator *allocator, zloc_header *block) {
+	#if !defined(zloc__ASAN)
+	if (!zloc__poisons_blocks(allocator)) return;
+	zloc__unpoison_memory(block, zloc__BLOCK_POINTER_OFFSET + zloc__POINTER_SIZE * 2);
+	#endif
+}
+#else
+#define zloc__poison_free_block(allocator, block)
+#define zloc__unpoison_allocation(allocator, block)
+#define zloc__unpoison_header(allocator, block)
+#define zloc__poison_memory(ptr, size)
+#define zloc__unpoison_memory(ptr, size)
+#endif
+
+/*
+	Put the block in front of the first block in the list that's at a higher address. Only the first
+	ZLOC_ADDRESS_ORDER_SEARCH blocks after prev are looked at so that freeing stays O(1), if they're all lower then the
+	block goes after the last one looked at. Lists that are longer then that are only roughly in order but the lowest
+	blocks still tend to collect at the front.
+*/
+static inline zloc__no_sanitize void zloc__insert_block_in_address_order(zloc_allocator *allocator, zloc_header *prev, zloc_header *block) {
+	for (int i = 1; i < ZLOC_ADDRESS_ORDER_SEARCH && prev->next_free_block != &allocator->null_block && (uintptr_t)prev->next_free_block < (uintptr_t)block; ++i) {
+		prev = prev->next_free_block;
+	}
+	zloc_header *next = prev->next_free_block;
+	block->next_free_block = next;
+	block->prev_free_block = prev;
+	prev->next_free_block = block;
+	next->prev_free_block = block;
+}
+
+/*
+	Push a block onto the segregated list of free blocks. Called when zloc_Free is called. Generally blocks are
+	merged if possible before this is called
+*/
+static inline zloc__no_sanitize void zloc__push_block(zloc_allocator *allocator, zloc_header *block) {
+	zloc_index fli;
+	zloc_index sli;
+	//Get the size class of the block
+	zloc__map(zloc__do_size_class_callback(block), &fli, &sli);
+	zloc_header *current_block_in_free_list = allocator->segregated_lists[fli][sli];
+	//If you hit this assert then it's likely that at somepoint in your code you're trying to free an allocation
+	//that was already freed or trying to free something that wasn't allocated by the allocator.
+	ZLOC_ASSERT(block != current_block_in_free_list);
+	if (allocator->pool_policy == zloc_pool_policy_lowest_address && current_block_in_free_list != &allocator->null_block && (uintptr_t)current_block_in_free_list < (uintptr_t)block) {
+		//There's a lower block already at the front of the list so the block goes somewhere after it
+		zloc__insert_block_in_address_order(allocator, current_block_in_free_list, block);
+	} else {
+		//Insert the block into the list by updating the next and prev free blocks of
+		//this and the current block in the free list. The current block in the free
+		//list may well be the null_block in the allocator so this just means that this
+		//block will be added as the first block in this class of free blocks.
+		block->next_free_block = current_block_in_free_list;
+		block->prev_free_block = &allocator->null_block;
+		current_block_in_free_list->prev_free_block = block;
+
+		allocator->segregated_lists[fli][sli] = block;
+	}
+	//Flag the bitmaps to mark that this size class now contains a free block
+	allocator->first_level_bitmap |= ZLOC_ONE << fli;
+	allocator->second_level_bitmaps[fli] |= 1U << sli;
+	if (allocator->first_level_bitmap & (ZLOC_ONE << fli)) {
+		ZLOC_ASSERT(allocator->second_level_bitmaps[fli] > 0);
+	}
+	zloc__mark_block_as_free(block);
+	allocator->free_list_bytes[fli][sli] += zloc__do_size_class_callback(block);
+	allocator->stats.free += zloc__block_size(block);
+	allocator->stats.free_blocks++;
+	allocator->stats.blocks_in_use--;
+	#ifdef ZLOC_EXTRA_DEBUGGING
+	zloc__verify_lists(allocator);
+	#endif
+	zloc__poison_free_block(allocator, block);
+}
+
+/*
+	Remove a block from the segregated list in the allocator and return it. If there is a next free block in the size class
+	then move it down the list, otherwise unflag the bitmaps as necessary. This is only called when we're trying to allocate
+	some memory with zloc_Allocate and we've determined that there's a suitable free block in segregated_lists.
+*/
+static inline zloc__no_sanitize zloc_header *zloc__pop_block(zloc_allocator *allocator, zloc_index fli, zloc_index sli) {
+	zloc_header *block = allocator->segregated_lists[fli][sli];
+
+	//If the block in the segregated list is actually the null_block then something went very wrong.
+	//Somehow the segregated lists had the end block assigned but the first or second level bitmaps
 	//did not have the masks assigned
 	ZLOC_ASSERT(block != &allocator->null_block);
 	if (block->next_free_block && block->next_free_block != &allocator->null_block) {
@@ -669,6 +1512,7 @@ static inline zloc_header *zloc__pop_block(zloc_allocator *allocator, zloc_index
 	#ifdef ZLOC_SAFEGUARDS
 	block->allocator = allocator;
 	#endif
+	allocator->free_list_bytes[fli][sli] -= zloc__do_size_class_callback(block);
 	allocator->stats.free -= zloc__block_size(block);
 	allocator->stats.free_blocks--;
 	allocator->stats.blocks_in_use++;
@@ -682,7 +1526,7 @@ static inline zloc_header *zloc__pop_block(zloc_allocator *allocator, zloc_index
 	Remove a block from the segregated list. This is only called when we're merging blocks together. The block is
 	just removed from the list and marked as used and then merged with an adjacent block.
 */
-static inline void zloc__remove_block_from_segregated_list(zloc_allocator *allocator, zloc_header *block) {
+static inline zloc__no_sanitize void zloc__remove_block_from_segregated_list(zloc_allocator *allocator, zloc_header *block) {
 	zloc_index fli, sli;
 	//Get the size class
 	zloc__map(zloc__do_size_class_callback(block), &fli, &sli);
@@ -705,6 +1549,7 @@ static inline void zloc__remove_block_from_segregated_list(zloc_allocator *alloc
 		ZLOC_ASSERT(allocator->second_level_bitmaps[fli] > 0);
 	}
 	zloc__mark_block_as_used(block);
+	allocator->free_list_bytes[fli][sli] -= zloc__do_size_class_callback(block);
 	allocator->stats.free -= zloc__block_size(block);
 	allocator->stats.free_blocks--;
 	#ifdef ZLOC_EXTRA_DEBUGGING
@@ -718,7 +1563,7 @@ static inline void zloc__remove_block_from_segregated_list(zloc_allocator *alloc
 	If not then it simply returns the free block as it is without splitting.
 	If split then the trimmed amount is added back to the segregated list of free blocks.
 */
-static inline zloc_header *zloc__maybe_split_block(zloc_allocator *allocator, zloc_header *block, zloc_size size, zloc_size remote_size) {
+static inline zloc__no_sanitize zloc_header *zloc__maybe_split_block(zloc_allocator *allocator, zloc_header *block, zloc_size size, zloc_size remote_size) {
 	//If you crash here it could be that you tried to free something that isn't actually a block allocation,
 	//perhaps it's the first object in a list that was allocated like a zest store resource. So when that got
 	//freed it could be added to the free block lists as a 0 sized block.
@@ -727,13 +1572,18 @@ static inline zloc_header *zloc__maybe_split_block(zloc_allocator *allocator, zl
 	if (size_plus_overhead + zloc__MINIMUM_BLOCK_SIZE >= zloc__block_size(block) - zloc__block_extension_size) {
 		return block;
 	}
+	zloc__count_split(allocator, block);
+	zloc_size zero_flag = zloc__zero_flag(block);
 	zloc_header *trimmed = (zloc_header*)((char*)zloc__block_user_ptr(block) + size + zloc__block_extension_size);
+	zloc__unpoison_header(allocator, trimmed);
 	trimmed->size = 0;
 	zloc__set_block_size(trimmed, zloc__block_size(block) - size_plus_overhead);
 	zloc_header *next_block = zloc__next_physical_block(block);
 	zloc__set_prev_physical_block(next_block, trimmed);
 	zloc__set_prev_physical_block(trimmed, block);
 	zloc__set_block_size(block, size + zloc__block_extension_size);
+	zloc__set_zero_flag(block, zero_flag);
+	zloc__set_zero_flag(trimmed, zero_flag);
 	//Note if this callback calls back into reallocate or allocate functions then you will get a spin lock.
 	zloc__do_split_block_callback;
 	allocator->stats.blocks_in_use++;
@@ -741,11 +1591,18 @@ static inline zloc_header *zloc__maybe_split_block(zloc_allocator *allocator, zl
 	return block;
 }
 
+//The size a block of block_size ends up as once zloc__maybe_split_block has trimmed it down to size
+static inline zloc_size zloc__size_after_split(const zloc_allocator *allocator, zloc_size block_size, zloc_size size) {
+	zloc_size size_plus_overhead = size + zloc__BLOCK_POINTER_OFFSET + zloc__block_extension_size;
+	return size_plus_overhead + zloc__MINIMUM_BLOCK_SIZE >= block_size - zloc__block_extension_size ? block_size : size + zloc__block_extension_size;
+}
+
 //For splitting blocks when allocating to a specific memory alignment
-static inline zloc_header *zloc__split_aligned_block(zloc_allocator *allocator, zloc_header *block, zloc_size size) {
+static inline zloc__no_sanitize zloc_header *zloc__split_aligned_block(zloc_allocator *allocator, zloc_header *block, zloc_size size) {
 	ZLOC_ASSERT(!zloc__is_last_block_in_pool(block));
 	zloc_size size_minus_overhead = size - zloc__BLOCK_POINTER_OFFSET;
 	zloc_header *trimmed = (zloc_header*)((char*)zloc__block_user_ptr(block) + size_minus_overhead);
+	zloc__unpoison_header(allocator, trimmed);
 	trimmed->size = 0;
 	zloc__set_block_size(trimmed, zloc__block_size(block) - size);
 	zloc_header *next_block = zloc__next_physical_block(block);
@@ -760,22 +1617,32 @@ static inline zloc_header *zloc__split_aligned_block(zloc_allocator *allocator,
 	return trimmed;
 }
 
+//If the verify cursor is on a block that's about to be merged into another then move it to that one
+static inline void zloc__move_verify_cursor(zloc_allocator *allocator, const zloc_header *merged, zloc_header *into) {
+	if (allocator->verify_cursor && allocator->verify_cursor->block == merged) {
+		allocator->verify_cursor->block = into;
+	}
+}
+
 /*
 	This function is called when zloc_Free is called and the previous physical block is free. If that's the case
 	then this function will merge the block being freed with the previous physical block then add that back into
 	the segregated list of free blocks. Note that that happens in the zloc_Free function after attempting to merge
 	both ways.
 */
-static inline zloc_header *zloc__merge_with_prev_block(zloc_allocator *allocator, zloc_header *block) {
+static inline zloc__no_sanitize zloc_header *zloc__merge_with_prev_block(zloc_allocator *allocator, zloc_header *block) {
 	ZLOC_ASSERT(!zloc__is_last_block_in_pool(block));
 	zloc_header *prev_block = block->prev_physical_block;
+	(void)zloc__header_is_intact(prev_block);
 	zloc__remove_block_from_segregated_list(allocator, prev_block);
 	//Note if this callback calls back into reallocate or allocate functions then you will get a spin lock.
 	zloc__do_merge_prev_callback;
+	zloc__move_verify_cursor(allocator, block, prev_block);
 	zloc__set_block_size(prev_block, zloc__block_size(prev_block) + zloc__block_size(block) + zloc__BLOCK_POINTER_OFFSET);
 	zloc_header *next_block = zloc__next_physical_block(block);
 	zloc__set_prev_physical_block(next_block, prev_block);
 	zloc__zero_block(block);
+	zloc__count_merge(allocator, prev_block);
 	return prev_block;
 }
 
@@ -783,17 +1650,97 @@ static inline zloc_header *zloc__merge_with_prev_block(zloc_allocator *allocator
 	This function might be called when zloc_Free is called to free a block. If the block being freed is not the last
 	physical block then this function is called and if the next block is free then it will be merged.
 */
-static inline void zloc__merge_with_next_block(zloc_allocator *allocator, zloc_header *block) {
+static inline zloc__no_sanitize void zloc__merge_with_next_block(zloc_allocator *allocator, zloc_header *block) {
 	zloc_header *next_block = zloc__next_physical_block(block);
+	(void)zloc__header_is_intact(next_block);
 	ZLOC_ASSERT(next_block->prev_physical_block == block);	//could be potentional memory corruption. Check that you're not writing outside the boundary of the block size
 	ZLOC_ASSERT(!zloc__is_last_block_in_pool(next_block));
 	zloc__remove_block_from_segregated_list(allocator, next_block);
 	//Note if this callback calls back into reallocate or allocate functions then you will get a spin lock.
 	zloc__do_merge_next_callback;
+	zloc__move_verify_cursor(allocator, next_block, block);
 	zloc__set_block_size(block, zloc__block_size(next_block) + zloc__block_size(block) + zloc__BLOCK_POINTER_OFFSET);
 	zloc_header *block_after_next = zloc__next_physical_block(next_block);
 	zloc__set_prev_physical_block(block_after_next, block);
 	zloc__zero_block(next_block);
+	zloc__count_merge(allocator, block);
+}
+
+/*
+	Trim a used block down to size and hand the tail back to the free lists. If the next physical block is free then
+	it's merged in first so that the tail gets coalesced with it instead of leaving 2 free blocks next to each other,
+	but only when there's a tail to split off, otherwise it would just be split off again the same as it was.
+*/
+static inline zloc_header *zloc__shrink_block(zloc_allocator *allocator, zloc_header *block, zloc_size size, zloc_size remote_size) {
+	zloc_size block_size = zloc__block_size(block);
+	if (size + zloc__block_extension_size >= block_size) {
+		return block;
+	}
+	if (zloc__next_block_is_free(block)) {
+		zloc_size merged_size = block_size + zloc__BLOCK_POINTER_OFFSET + zloc__block_size(zloc__next_physical_block(block));
+		if (zloc__size_after_split(allocator, merged_size, size) != merged_size) {
+			zloc__merge_with_next_block(allocator, block);
+			zloc__mark_block_as_used(block);
+		}
+	}
+	return zloc__maybe_split_block(allocator, block, size, remote_size);
+}
+
+//Put a block taken from the free lists straight back without it counting as an allocation, merging it with any free
+//neighbours. Lock must already be held.
+static inline zloc__no_sanitize void zloc__return_block(zloc_allocator *allocator, zloc_header *block) {
+	if (zloc__prev_is_free_block(block)) {
+		ZLOC_ASSERT(block->prev_physical_block);		//Must be a valid previous physical block
+		block = zloc__merge_with_prev_block(allocator, block);
+	}
+	if (zloc__next_block_is_free(block)) {
+		zloc__merge_with_next_block(allocator, block);
+	}
+	zloc__push_block(allocator, block);
+}
+
+//Merge a used block with any free neighbours and put it back in the free lists. Lock must already be held.
+static inline zloc__no_sanitize void zloc__free_block(zloc_allocator *allocator, zloc_header *block) {
+	zloc__count_free(allocator, block);
+	zloc__tag_free(allocator, block);
+	zloc__return_block(allocator, block);
+}
+
+/*
+	The amount of room a block would have if it was merged with the previous physical block and also the next physical
+	block if that's free. Only valid to call if the previous block is free.
+*/
+static inline zloc__no_sanitize zloc_size zloc__backward_growth_size(const zloc_header *block) {
+	zloc_size size = zloc__block_size(block->prev_physical_block) + zloc__BLOCK_POINTER_OFFSET + zloc__block_size(block);
+	if (zloc__next_block_is_free(block)) {
+		size += zloc__block_size(zloc__next_physical_block(block)) + zloc__BLOCK_POINTER_OFFSET;
+	}
+	return size;
+}
+
+/*
+	Called when reallocating a block that can't grow in place but the previous physical block is free and there's
+	enough room between them. The next block is merged in too if it's free so that trimming the block afterwards
+	never leaves 2 free blocks next to each other. The previous block becomes the allocation, it's up to the caller
+	to move the contents down to the new start of the block.
+*/
+static inline zloc__no_sanitize zloc_header *zloc__merge_for_backward_growth(zloc_allocator *allocator, zloc_header *block) {
+	ZLOC_ASSERT(zloc__prev_is_free_block(block));
+	#ifdef ZLOC_ENABLE_TAGGING
+	zloc_size tag = block->tag;
+	#endif
+	if (zloc__next_block_is_free(block)) {
+		zloc__merge_with_next_block(allocator, block);
+	}
+	block = zloc__merge_with_prev_block(allocator, block);
+	zloc__mark_block_as_used(block);
+	#ifdef ZLOC_SAFEGUARDS
+	block->allocator = allocator;
+	#endif
+	#ifdef ZLOC_ENABLE_TAGGING
+	block->tag = tag;
+	#endif
+	return block;
 }
 
 static inline zloc_header *zloc__find_free_block(zloc_allocator *allocator, zloc_size size, zloc_size remote_size) {
@@ -807,28 +1754,21 @@ static inline zloc_header *zloc__find_free_block(zloc_allocator *allocator, zloc
 		zloc_header *block = zloc__pop_block(allocator, fli, sli);
 		return block;
 	}
-	if (sli == zloc__SECOND_LEVEL_INDEX_COUNT - 1) {
-		sli = -1;
-	}
-	else {
-		sli = zloc__find_next_size_up(allocator->second_level_bitmaps[fli], sli);
-	}
-	if (sli == -1) {
-		fli = zloc__find_next_size_up(allocator->first_level_bitmap, fli);
-		if (fli > -1) {
-			sli = zloc__scan_forward(allocator->second_level_bitmaps[fli]);
-			zloc_header *block = zloc__pop_block(allocator, fli, sli);
-			zloc_header *split_block = zloc__call_maybe_split_block;
-			return split_block;
-		}
-	}
-	else {
-		zloc_header *block = zloc__pop_block(allocator, fli, sli);
-		zloc_header *split_block = zloc__call_maybe_split_block;
-		return split_block;
+	zloc__count_escalation(allocator, fli, sli);
+	//Escalate to the next class up, which is either further along this second level or the first class of the next first
+	//level that has anything in it. Work out both and select with a mask so that the only branch left is the rarely taken
+	//out of memory one. Shifting 64 bits by sli + 1 can't overflow so the last second level class needs no special case.
+	zloc_sl_bitmap above = (zloc_sl_bitmap)(~0ULL << (sli + 1));
+	zloc_index same_level = -(zloc_index)((allocator->second_level_bitmaps[fli] & above) != 0);
+	zloc_index next_fli = zloc__find_next_size_up(allocator->first_level_bitmap, fli);
+	fli = (fli & same_level) | (next_fli & ~same_level);
+	if (fli < 0) {
+		return 0;
 	}
-
-	return 0;
+	sli = zloc__scan_forward(allocator->second_level_bitmaps[fli] & (above | ~(zloc_sl_bitmap)same_level));
+	zloc_header *block = zloc__pop_block(allocator, fli, sli);
+	zloc_header *split_block = zloc__call_maybe_split_block;
+	return split_block;
 }
 
 #ifdef __cplusplus
@@ -841,6 +1781,249 @@ static inline zloc_header *zloc__find_free_block(zloc_allocator *allocator, zloc
 //--End of header declarations
 #if defined(ZLOC_IMPLEMENTATION)
 
+#ifdef ZLOC_ENABLE_TRACING
+//Define ZLOC_TRACE_TIMESTAMP and ZLOC_TRACE_THREAD_ID yourself if you want to use your own clock or thread ids
+#if !defined(ZLOC_TRACE_TIMESTAMP) || !defined(ZLOC_TRACE_THREAD_ID)
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#endif
+#endif
+
+#ifndef ZLOC_TRACE_TIMESTAMP
+static inline uint64_t zloc__trace_timestamp(void) {
+	#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)((double)counter.QuadPart * 1000000000.0 / (double)frequency.QuadPart);
+	#else
+	struct timespec now;
+	#if defined(CLOCK_MONOTONIC)
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	#else
+	//Strict ISO C builds don't declare clock_gettime
+	timespec_get(&now, TIME_UTC);
+	#endif
+	return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+	#endif
+}
+#define ZLOC_TRACE_TIMESTAMP() zloc__trace_timestamp()
+#endif
+
+#ifndef ZLOC_TRACE_THREAD_ID
+static inline uint32_t zloc__trace_thread_id(void) {
+	#ifdef _WIN32
+	return (uint32_t)GetCurrentThreadId();
+	#else
+	return (uint32_t)(uintptr_t)pthread_self();
+	#endif
+}
+#define ZLOC_TRACE_THREAD_ID() zloc__trace_thread_id()
+#endif
+
+static inline uint64_t zloc__trace_offset(const zloc_allocator *allocator, const void *allocation) {
+	return allocation ? (uint64_t)((uintptr_t)allocation - (uintptr_t)allocator) : 0;
+}
+
+static void zloc__flush_trace(zloc_trace_buffer *trace) {
+	//The ring can wrap around so it might take 2 calls to hand over the events in order
+	zloc_size first = zloc__Min(trace->count, trace->capacity - trace->start);
+	if (first) {
+		trace->flush_callback(trace->user_data, trace->events + trace->start, first);
+	}
+	if (trace->count > first) {
+		trace->flush_callback(trace->user_data, trace->events, trace->count - first);
+	}
+	trace->start = 0;
+	trace->count = 0;
+}
+
+/*
+	Record an event into the allocator's trace buffer. This is called with the allocator lock held so the order of the
+	events always matches the order that blocks were handed out and given back, even across threads.
+*/
+static void zloc__trace(zloc_allocator *allocator, zloc_trace_op op, const void *ptr, const void *allocation, zloc_size size, zloc_size alignment) {
+	zloc_trace_buffer *trace = allocator->trace;
+	zloc_trace_event event;
+	event.timestamp = ZLOC_TRACE_TIMESTAMP();
+	event.size = size;
+	event.offset = zloc__trace_offset(allocator, allocation);
+	event.previous_offset = zloc__trace_offset(allocator, ptr);
+	event.thread_id = ZLOC_TRACE_THREAD_ID();
+	event.op = (uint8_t)op;
+	event.alignment_log2 = alignment ? (uint8_t)zloc__scan_reverse(alignment) : 0;
+	event.reserved = 0;
+	zloc__lock_thread_access(trace);
+	if (trace->count == trace->capacity) {
+		if (trace->flush_callback) {
+			zloc__flush_trace(trace);
+		} else {
+			//Overwrite the oldest event
+			trace->start = (trace->start + 1) % trace->capacity;
+			trace->count--;
+			trace->dropped++;
+		}
+	}
+	trace->events[(trace->start + trace->count) % trace->capacity] = event;
+	trace->count++;
+	zloc__unlock_thread_access(trace);
+}
+
+static inline void zloc__record_trace(zloc_allocator *allocator, zloc_trace_op op, const void *ptr, const void *allocation, zloc_size size, zloc_size alignment) {
+	if (allocator->trace) {
+		zloc__trace(allocator, op, ptr, allocation, size, alignment);
+	}
+}
+#else
+#define zloc__record_trace(allocator, op, ptr, allocation, size, alignment)
+#endif
+
+#ifdef ZLOC_ENABLE_SAMPLING
+//Define ZLOC_SAMPLE_BACKTRACE(frames, max_frames) to capture stacks your own way, it should return the number of
+//return addresses written to frames
+#ifndef ZLOC_SAMPLE_BACKTRACE
+#if defined(_WIN32)
+#define ZLOC_SAMPLE_BACKTRACE(frames, max_frames) (int)RtlCaptureStackBackTrace(0, (DWORD)(max_frames), (frames), 0)
+#elif defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define zloc__SAMPLE_SYMBOLS
+#define ZLOC_SAMPLE_BACKTRACE(frames, max_frames) backtrace((frames), (int)(max_frames))
+#else
+#define ZLOC_SAMPLE_BACKTRACE(frames, max_frames) 0
+#endif
+#endif
+
+//-ln(u) for u in (0, 1], done here so that sampling doesn't need libm. Good to about 1 part in 10^6 which is plenty
+//for spacing samples out.
+static inline double zloc__negative_log(double u) {
+	//u = m * 2^-e with m in [1, 2), then ln(m) = 2 * atanh((m - 1) / (m + 1))
+	int e = 0;
+	while (u < 1.0) {
+		u *= 2.0;
+		e++;
+	}
+	double t = (u - 1.0) / (u + 1.0);
+	double t2 = t * t;
+	double ln_m = 2.0 * t * (1.0 + t2 * (1.0 / 3.0 + t2 * (1.0 / 5.0 + t2 * (1.0 / 7.0 + t2 * (1.0 / 9.0 + t2 * (1.0 / 11.0 + t2 / 13.0))))));
+	return (double)e * 0.69314718055994531 - ln_m;
+}
+
+//1 - e^-x for x >= 0 without libm. The series is used directly for the small x that most allocations have, where
+//working out e^-x first and taking it away from 1 would lose most of the precision.
+static inline double zloc__one_minus_exp_negative(double x) {
+	if (x > 40.0) {
+		return 1.0;
+	}
+	//e^-x = 2^-n * e^-r with r in [0, ln 2)
+	int n = (int)(x * 1.4426950408889634);
+	double r = x - (double)n * 0.69314718055994531;
+	double sum = 0.0;
+	double term = r;
+	for (int i = 1; i != 18; ++i) {
+		sum += term;
+		term *= -r / (double)(i + 1);
+	}
+	if (!n) {
+		return sum;
+	}
+	double e = 1.0 - sum;
+	while (n--) {
+		e *= 0.5;
+	}
+	return 1.0 - e;
+}
+
+//Gaps between samples are exponentially distributed so that allocation patterns that repeat every so many bytes
+//can't line up with the sampler and hide from it
+static inline zloc_size zloc__next_sample_interval(zloc_sampler *sampler) {
+	uint64_t x = sampler->random_state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	sampler->random_state = x;
+	double uniform = ((double)(x >> 11) + 1.0) * (1.0 / 9007199254740992.0);
+	double interval = zloc__negative_log(uniform) * (double)sampler->sample_rate;
+	return interval < 1.0 ? 1 : (zloc_size)interval;
+}
+
+static zloc_sample_callsite *zloc__find_callsite(zloc_sampler *sampler, uint64_t hash, void **frames, zloc_size depth) {
+	zloc_size index = (zloc_size)hash & (ZLOC_SAMPLE_CALLSITES - 1);
+	for (zloc_size probe = 0; probe != ZLOC_SAMPLE_CALLSITES; ++probe) {
+		zloc_sample_callsite *callsite = &sampler->callsites[(index + probe) & (ZLOC_SAMPLE_CALLSITES - 1)];
+		if (!callsite->samples) {
+			memcpy(callsite->frames, frames, depth * sizeof(void*));
+			callsite->hash = hash;
+			callsite->depth = depth;
+			sampler->callsite_count++;
+			return callsite;
+		}
+		if (callsite->hash == hash && callsite->depth == depth && memcmp(callsite->frames, frames, depth * sizeof(void*)) == 0) {
+			return callsite;
+		}
+	}
+	return 0;
+}
+
+/*
+	Called with the allocator lock held when the byte countdown runs out. Only the countdown is reset here, the
+	backtrace is left to zloc__record_sample once the lock is released so that other threads aren't kept waiting on
+	the unwind (and so that a backtrace that mallocs can't deadlock if malloc ends up in this allocator). Returns the
+	sampler to record the allocation in.
+*/
+static zloc_sampler *zloc__start_sample(zloc_allocator *allocator) {
+	zloc_sampler *sampler = allocator->sampler;
+	if (!sampler) {
+		//Nothing to sample into, push the next sample out of reach until there is
+		allocator->bytes_until_sample = ~(zloc_size)0;
+		return 0;
+	}
+	zloc__lock_thread_access(sampler);
+	allocator->bytes_until_sample = zloc__next_sample_interval(sampler);
+	zloc__unlock_thread_access(sampler);
+	return sampler;
+}
+
+/*
+	Take the backtrace and add it to the sampler. Called without the allocator lock. Each sample stands in for every
+	allocation since the last one, so the bytes are scaled up by the chance of an allocation of that size being sampled.
+*/
+static void zloc__record_sample(zloc_sampler *sampler, zloc_size size) {
+	void *frames[ZLOC_SAMPLE_MAX_FRAMES + 1];
+	int captured = ZLOC_SAMPLE_BACKTRACE(frames, ZLOC_SAMPLE_MAX_FRAMES + 1);
+	//Skip the frame for this function
+	zloc_size depth = captured > 1 ? (zloc_size)captured - 1 : 0;
+	uint64_t hash = 14695981039346656037ull;
+	for (zloc_size i = 0; i != depth; ++i) {
+		hash = (hash ^ (uint64_t)(uintptr_t)frames[i + 1]) * 1099511628211ull;
+	}
+	double rate = (double)sampler->sample_rate;
+	zloc_size estimated_bytes = (zloc_size)((double)size / zloc__one_minus_exp_negative((double)size / rate));
+	zloc__lock_thread_access(sampler);
+	zloc_sample_callsite *callsite = zloc__find_callsite(sampler, hash, frames + 1, depth);
+	if (callsite) {
+		callsite->samples++;
+		callsite->sampled_bytes += size;
+		callsite->estimated_bytes += estimated_bytes;
+	} else {
+		sampler->dropped++;
+	}
+	sampler->samples++;
+	zloc__unlock_thread_access(sampler);
+}
+
+//All an allocation that isn't sampled pays for is counting down the bytes to the next sample
+static inline zloc_sampler *zloc__sample_allocation(zloc_allocator *allocator, zloc_size size) {
+	if (allocator->bytes_until_sample > size) {
+		allocator->bytes_until_sample -= size;
+		return 0;
+	}
+	return zloc__start_sample(allocator);
+}
+#endif
+
 //Definitions
 ZLOC_API void* zloc_BlockUserExtensionPtr(const zloc_header *block) {
 	return (char*)block + sizeof(zloc_header);
@@ -905,11 +2088,23 @@ void zloc_SetMinimumAllocationSize(zloc_allocator *allocator, zloc_size size) {
 	allocator->minimum_allocation_size = zloc__Max(zloc__MINIMUM_BLOCK_SIZE, size);
 }
 
+/*
+	Choose which free block in a size class gets handed out first. With zloc_pool_policy_lowest_address the free lists
+	are kept in address order so allocations come from the lowest pools first and the higher pools are left to empty
+	out, ready for zloc_RemovePool. Only blocks freed after the policy is set are put in order so set it before adding
+	more pools.
+*/
+void zloc_SetPoolPolicy(zloc_allocator *allocator, zloc_pool_policy policy) {
+	zloc__lock_thread_access(allocator);
+	allocator->pool_policy = policy;
+	zloc__unlock_thread_access(allocator);
+}
+
 zloc_pool *zloc_GetPool(zloc_allocator *allocator) {
 	return (zloc_pool*)((char*)allocator + zloc_AllocatorSize());
 }
 
-zloc_pool *zloc_AddPool(zloc_allocator *allocator, void *memory, zloc_size size) {
+static zloc__no_sanitize zloc_pool *zloc__add_pool(zloc_allocator *allocator, void *memory, zloc_size size, zloc_bool zeroed) {
 	zloc__lock_thread_access(allocator);
 
 	ZLOC_ASSERT(size <= zloc__MAXIMUM_BLOCK_SIZE && "Tried to add a memory pool that is larger then the maximum block size.");
@@ -935,7 +2130,10 @@ zloc_pool *zloc_AddPool(zloc_allocator *allocator, void *memory, zloc_size size)
 	zloc__block_set_used(last_block);
 
 	allocator->stats.capacity += zloc__block_size(block);
-	last_block->prev_physical_block = block;
+	zloc__set_prev_physical_block(last_block, block);
+	if (zeroed) {
+		zloc__set_zero_flag(block, zloc__BLOCK_IS_ZERO);
+	}
 	allocator->stats.blocks_in_use++;
 	zloc__push_block(allocator, block);
 
@@ -943,12 +2141,33 @@ zloc_pool *zloc_AddPool(zloc_allocator *allocator, void *memory, zloc_size size)
 	return (zloc_pool*)memory;
 }
 
+zloc_pool *zloc_AddPool(zloc_allocator *allocator, void *memory, zloc_size size) {
+	return zloc__add_pool(allocator, memory, size, 0);
+}
+
+#ifdef ZLOC_ENABLE_ZERO_TRACKING
+/*
+	Add a pool that you know is all zero already, like memory fresh from mmap or VirtualAlloc. zloc_AllocateZeroed won't
+	clear anything it allocates from the pool until it's been written to and freed.
+*/
+zloc_pool *zloc_AddZeroedPool(zloc_allocator *allocator, void *memory, zloc_size size) {
+	return zloc__add_pool(allocator, memory, size, 1);
+}
+#endif
+
 zloc_bool zloc_RemovePool(zloc_allocator *allocator, zloc_pool *pool) {
 	zloc__lock_thread_access(allocator);
 	zloc_header *block = zloc__first_block_in_pool(pool);
 
 	if (zloc__is_free_block(block) && !zloc__next_block_is_free(block) && zloc__is_last_block_in_pool(zloc__next_physical_block(block))) {
 		zloc__remove_block_from_segregated_list(allocator, block);
+		if (allocator->verify_cursor && allocator->verify_cursor->pool == pool) {
+			allocator->verify_cursor->pool = 0;
+			allocator->verify_cursor->block = 0;
+			allocator->verify_cursor = 0;
+		}
+		//Hand the memory back clean
+		zloc__unpoison_memory(pool, (char*)zloc__next_physical_block(block) + zloc__BLOCK_POINTER_OFFSET - (char*)pool);
 		zloc__unlock_thread_access(allocator);
 		return 1;
 	}
@@ -961,23 +2180,111 @@ zloc_bool zloc_RemovePool(zloc_allocator *allocator, zloc_pool *pool) {
 	return 0;
 }
 
-void *zloc__allocate(zloc_allocator *allocator, zloc_size size, zloc_size remote_size) {
+void *zloc__allocate(zloc_allocator *allocator, zloc_size size, zloc_size remote_size, zloc_uint tag, zloc_bool zeroed) {
 	zloc__lock_thread_access(allocator);
-	size = zloc__adjust_size(size, zloc__MINIMUM_BLOCK_SIZE, zloc__MEMORY_ALIGNMENT);
-	zloc_header *block = zloc__find_free_block(allocator, size, remote_size);
+	zloc_size adjusted_size = zloc__adjust_size(size, zloc__MINIMUM_BLOCK_SIZE, zloc__MEMORY_ALIGNMENT);
+	zloc_header *block = zloc__find_free_block(allocator, adjusted_size, remote_size);
+	//Tags are charged the size of the block that's found, which can be more then was asked for, so check against that
+	if (block && !zloc__tag_has_room(allocator, tag, zloc__do_size_class_callback(block))) {
+		zloc__return_block(allocator, block);
+		zloc__record_trace(allocator, zloc_trace_op_allocate, 0, 0, size, 0);
+		zloc__unlock_thread_access(allocator);
+		return 0;
+	}
 
 	if (block) {
+		zloc_bool block_is_zero = zloc__take_zero_flag(block);
+		zloc__count_allocation(allocator, block);
+		zloc__tag_allocation(allocator, block, tag);
+		#ifdef ZLOC_ENABLE_SAMPLING
+		zloc_sampler *sampler = zloc__sample_allocation(allocator, remote_size ? remote_size : size);
+		#endif
+		zloc__unpoison_allocation(allocator, block);
+		if (zeroed) {
+			//A zero block only has its free list pointers to clear
+			zloc__zero_allocation(block, 0, block_is_zero ? zloc__POINTER_SIZE * 2 : zloc__block_size(block));
+		}
+		zloc__record_trace(allocator, zloc_trace_op_allocate, 0, zloc__block_user_ptr(block), size, 0);
 		zloc__unlock_thread_access(allocator);
+		#ifdef ZLOC_ENABLE_SAMPLING
+		if (sampler) {
+			zloc__record_sample(sampler, remote_size ? remote_size : size);
+		}
+		#endif
 		return zloc__block_user_ptr(block);
 	}
 
 	//Out of memory;
 	ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Not enough memory in pool to allocate %llu bytes\n", ZLOC_ERROR_NAME, zloc__map_size);
+	zloc__record_trace(allocator, zloc_trace_op_allocate, 0, 0, size, 0);
 	zloc__unlock_thread_access(allocator);
 	return 0;
 }
 
-void *zloc_Reallocate(zloc_allocator *allocator, void *ptr, zloc_size size) {
+//Copies of at least this many bytes are done with non-temporal stores when moving a block, 0 to always use memcpy.
+//Around the size of the last level cache is best, under that a cached copy is quicker.
+#ifndef ZLOC_STREAMING_COPY_THRESHOLD
+#define ZLOC_STREAMING_COPY_THRESHOLD zloc__MEGABYTE(16)
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define zloc__STREAMING_COPY
+#endif
+
+/*
+	Copy the contents of a block that's being moved, the ranges mustn't overlap. memcpy is already vectorised so it's
+	used for anything under ZLOC_STREAMING_COPY_THRESHOLD. Bigger copies than that go straight to memory with SSE2
+	streaming stores instead of through the cache: they're quicker once the copy doesn't fit in the cache anyway, and
+	moving a block of many megabytes doesn't then throw everything else out of the cache with it.
+*/
+static inline void zloc__copy_memory(void *dst, const void *src, zloc_size size) {
+	#ifdef zloc__STREAMING_COPY
+	if (ZLOC_STREAMING_COPY_THRESHOLD != 0 && size >= ZLOC_STREAMING_COPY_THRESHOLD) {
+		char *d = (char*)dst;
+		const char *s = (const char*)src;
+		//Streaming stores have to be 16 byte aligned
+		zloc_size head = zloc__Min((16 - ((uintptr_t)d & 15)) & 15, size);
+		memcpy(d, s, head);
+		d += head;
+		s += head;
+		size -= head;
+		for (zloc_size chunks = size / 64; chunks; --chunks, d += 64, s += 64) {
+			__m128i a = _mm_loadu_si128((const __m128i*)s);
+			__m128i b = _mm_loadu_si128((const __m128i*)(s + 16));
+			__m128i c = _mm_loadu_si128((const __m128i*)(s + 32));
+			__m128i e = _mm_loadu_si128((const __m128i*)(s + 48));
+			_mm_stream_si128((__m128i*)d, a);
+			_mm_stream_si128((__m128i*)(d + 16), b);
+			_mm_stream_si128((__m128i*)(d + 32), c);
+			_mm_stream_si128((__m128i*)(d + 48), e);
+		}
+		//Streaming stores aren't ordered with normal ones, they need to be finished before the lock is released
+		_mm_sfence();
+		memcpy(d, s, size & 63);
+		return;
+	}
+	#endif
+	memcpy(dst, src, size);
+}
+
+#ifdef ZLOC_ENABLE_GUARD_PAGES
+static void *zloc__reallocate_guarded(zloc_allocator *allocator, void *ptr, zloc_size size, zloc_bool zeroed);
+#endif
+#ifdef ZLOC_ENABLE_QUARANTINE
+static void zloc__quarantine_block(zloc_allocator *allocator, zloc_header *block);
+#endif
+
+/*
+	When zeroed is set everything after the part of the old allocation that's kept is zero, up to the end of the block.
+	Growing in place into a zero block only needs the old header of that block cleared.
+*/
+static void *zloc__reallocate(zloc_allocator *allocator, void *ptr, zloc_size size, zloc_bool zeroed) {
+	#ifdef ZLOC_ENABLE_GUARD_PAGES
+	if (allocator->guard_pages) {
+		return zloc__reallocate_guarded(allocator, ptr, size, zeroed);
+	}
+	#endif
 	zloc__lock_thread_access(allocator);
 
 	if (ptr && size == 0) {
@@ -988,7 +2295,7 @@ void *zloc_Reallocate(zloc_allocator *allocator, void *ptr, zloc_size size) {
 
 	if (!ptr) {
 		zloc__unlock_thread_access(allocator);
-		return zloc__allocate(allocator, size, 0);
+		return zloc__allocate(allocator, size, 0, 0, zeroed);
 	}
 
 	zloc_header *block = zloc__block_from_allocation(ptr);
@@ -997,35 +2304,149 @@ void *zloc_Reallocate(zloc_allocator *allocator, void *ptr, zloc_size size) {
 	zloc_size current_size = zloc__block_size(block);
 	zloc_size adjusted_size = zloc__adjust_size(size, allocator->minimum_allocation_size, zloc__MEMORY_ALIGNMENT);
 	zloc_size combined_size = current_size + zloc__block_size(next_block);
+	//Growing is checked against the tag's budget with the size the block will actually end up as. If it would go over
+	//then the allocation is left as it is.
+	zloc_size grown_size = current_size;
 	if ((!zloc__next_block_is_free(block) || adjusted_size > combined_size) && adjusted_size > current_size) {
-		zloc_header *new_block = zloc__find_free_block(allocator, adjusted_size, 0);
-		if (new_block) {
-			allocation = zloc__block_user_ptr(new_block);
-		}
-		if (allocation) {
-			zloc_size smallest_size = zloc__Min(current_size, size);
-			memcpy(allocation, ptr, smallest_size);
-			//Note if this callback calls back into reallocate or allocate then you will get a spin lock.
-			zloc__do_unable_to_reallocate_callback;
-			zloc__unlock_thread_access(allocator);
-			zloc_Free(allocator, ptr);
-			zloc__lock_thread_access(allocator);
+		if (zloc__prev_is_free_block(block) && adjusted_size <= zloc__backward_growth_size(block)) {
+			grown_size = zloc__size_after_split(allocator, zloc__backward_growth_size(block), adjusted_size);
 		}
-	} else {
-		//Reallocation is possible
-		if (adjusted_size > current_size) {
-			zloc__merge_with_next_block(allocator, block);
-			zloc__mark_block_as_used(block);
+	} else if (adjusted_size > current_size) {
+		grown_size = zloc__size_after_split(allocator, current_size + zloc__BLOCK_POINTER_OFFSET + zloc__block_size(next_block), adjusted_size);
+	}
+	if (grown_size > current_size && !zloc__tag_has_room(allocator, zloc__block_tag(block), grown_size - current_size)) {
+		zloc__record_trace(allocator, zloc_trace_op_reallocate, ptr, 0, size, 0);
+		zloc__unlock_thread_access(allocator);
+		return 0;
+	}
+	if ((!zloc__next_block_is_free(block) || adjusted_size > combined_size) && adjusted_size > current_size) {
+		if (zloc__prev_is_free_block(block) && adjusted_size <= zloc__backward_growth_size(block)) {
+			//Grow backwards into the free previous block and shift the contents down rather then searching
+			//the free lists for a new block
+			block = zloc__merge_for_backward_growth(allocator, block);
+			allocation = zloc__block_user_ptr(block);
+			zloc__unpoison_allocation(allocator, block);
+			zloc_size kept_size = zloc__Min(current_size, size);
+			if ((char*)allocation + kept_size <= (char*)ptr) {
+				zloc__copy_memory(allocation, ptr, kept_size);
+			} else {
+				memmove(allocation, ptr, kept_size);
+			}
+			zloc__maybe_split_block(allocator, block, adjusted_size, 0);
+			zloc__unpoison_allocation(allocator, block);
+			if (zeroed) {
+				zloc__zero_allocation(block, kept_size, zloc__block_size(block));
+			}
+			zloc__count_resize(allocator, current_size, block);
+			zloc__tag_resize(allocator, current_size, block);
+			zloc__record_trace(allocator, zloc_trace_op_reallocate, ptr, allocation, size, 0);
+			zloc__unlock_thread_access(allocator);
+			return allocation;
+		}
+		zloc_header *new_block = zloc__find_free_block(allocator, adjusted_size, 0);
+		if (new_block && !zloc__tag_has_room(allocator, zloc__block_tag(block), zloc__block_size(new_block) - current_size)) {
+			zloc__return_block(allocator, new_block);
+			zloc__record_trace(allocator, zloc_trace_op_reallocate, ptr, 0, size, 0);
+			zloc__unlock_thread_access(allocator);
+			return 0;
 		}
+		zloc_bool block_is_zero = 0;
+		if (new_block) {
+			block_is_zero = zloc__take_zero_flag(new_block);
+			allocation = zloc__block_user_ptr(new_block);
+			zloc__count_allocation(allocator, new_block);
+			zloc__tag_allocation(allocator, new_block, zloc__block_tag(block));
+			zloc__unpoison_allocation(allocator, new_block);
+		}
+		if (allocation) {
+			zloc_size smallest_size = zloc__Min(current_size, size);
+			zloc__copy_memory(allocation, ptr, smallest_size);
+			if (zeroed) {
+				zloc__zero_allocation(new_block, smallest_size, block_is_zero ? zloc__POINTER_SIZE * 2 : zloc__block_size(new_block));
+			}
+			//Note if this callback calls back into reallocate or allocate then you will get a spin lock.
+			zloc__do_unable_to_reallocate_callback;
+			zloc_header *old_block = zloc__block_from_allocation(ptr);
+			#ifdef ZLOC_ENABLE_QUARANTINE
+			//Hold on to the old block the same as zloc_Free would so writes through the old pointer are still caught
+			if (allocator->quarantine_size) {
+				zloc__quarantine_block(allocator, old_block);
+			} else {
+				zloc__free_block(allocator, old_block);
+			}
+			#else
+			zloc__free_block(allocator, old_block);
+			#endif
+		}
+	} else if (adjusted_size > current_size) {
+		//Reallocation is possible
+		zloc_bool next_is_zero = zloc__zero_flag(next_block) != 0;
+		zloc__merge_with_next_block(allocator, block);
+		zloc__mark_block_as_used(block);
 		zloc_header *split_block = zloc__maybe_split_block(allocator, block, adjusted_size, 0);
 		allocation = zloc__block_user_ptr(split_block);
+		zloc__count_resize(allocator, current_size, block);
+		zloc__tag_resize(allocator, current_size, block);
+		zloc__unpoison_allocation(allocator, block);
+		if (zeroed) {
+			zloc__zero_allocation(block, current_size, next_is_zero ? current_size + zloc__BLOCK_POINTER_OFFSET + zloc__POINTER_SIZE * 2 : zloc__block_size(block));
+		}
+	} else if (adjusted_size == current_size) {
+		//Already the right size
+		allocation = ptr;
+	} else {
+		allocation = zloc__block_user_ptr(zloc__shrink_block(allocator, block, adjusted_size, 0));
+		zloc__count_resize(allocator, current_size, block);
+		zloc__tag_resize(allocator, current_size, block);
+		zloc__unpoison_allocation(allocator, block);
 	}
 
+	zloc__record_trace(allocator, zloc_trace_op_reallocate, ptr, allocation, size, 0);
 	zloc__unlock_thread_access(allocator);
 	return allocation;
 }
 
-void *zloc_AllocateAligned(zloc_allocator *allocator, zloc_size size, zloc_size alignment) {
+void *zloc_Reallocate(zloc_allocator *allocator, void *ptr, zloc_size size) {
+	return zloc__reallocate(allocator, ptr, size, 0);
+}
+
+/*
+	Like zloc_Reallocate but anything past the old size of the allocation is zero. Only the bytes past the old size are
+	cleared so if the allocation came from zloc_AllocateZeroed (or this) then everything you haven't written to is zero.
+*/
+void *zloc_ReallocateZeroed(zloc_allocator *allocator, void *ptr, zloc_size size) {
+	return zloc__reallocate(allocator, ptr, size, 1);
+}
+
+/*
+	Shrink an allocation in place. The memory after the new size is split off and returned to the free lists straight
+	away, merged with the next block if that's free. The allocation never moves so the pointer returned is always the
+	same as the one passed in. If the size is bigger then the current size then nothing happens.
+*/
+zloc__no_sanitize void *zloc_Shrink(zloc_allocator *allocator, void *ptr, zloc_size size) {
+	if (!ptr) {
+		return 0;
+	}
+	zloc__lock_thread_access(allocator);
+	zloc_header *block = zloc__block_from_allocation(ptr);
+	#ifdef ZLOC_SAFEGUARDS
+	ZLOC_ASSERT(block->allocator == allocator);
+	#endif
+	zloc_size adjusted_size = zloc__adjust_size(size, allocator->minimum_allocation_size, zloc__MEMORY_ALIGNMENT);
+	zloc_size current_size = zloc__block_size(block);
+	if (adjusted_size < current_size) {
+		zloc__shrink_block(allocator, block, adjusted_size, 0);
+		zloc__count_resize(allocator, current_size, block);
+		zloc__tag_resize(allocator, current_size, block);
+		zloc__unpoison_allocation(allocator, block);
+	}
+	//Replays as a reallocation, which shrinks in place in the same way
+	zloc__record_trace(allocator, zloc_trace_op_reallocate, ptr, ptr, size, 0);
+	zloc__unlock_thread_access(allocator);
+	return ptr;
+}
+
+static void *zloc__allocate_aligned(zloc_allocator *allocator, zloc_size size, zloc_size alignment, zloc_uint tag) {
 	zloc__lock_thread_access(allocator);
 	zloc_size adjusted_size = zloc__adjust_size(size, allocator->minimum_allocation_size, alignment);
 	zloc_size gap_minimum = sizeof(zloc_header);
@@ -1035,6 +2456,7 @@ void *zloc_AllocateAligned(zloc_allocator *allocator, zloc_size size, zloc_size
 	zloc_header *block = zloc__find_free_block(allocator, aligned_size, 0);
 
 	if (block) {
+		(void)zloc__take_zero_flag(block);
 		void *user_ptr = zloc__block_user_ptr(block);
 		void *aligned_ptr = zloc__align_ptr(user_ptr, alignment);
 		zloc_size gap = (zloc_size)((uintptr_t)aligned_ptr - (uintptr_t)user_ptr);
@@ -1059,35 +2481,354 @@ void *zloc_AllocateAligned(zloc_allocator *allocator, zloc_size size, zloc_size
 		ZLOC_ASSERT(zloc__ptr_is_aligned(zloc__block_user_ptr(block), alignment));	//pointer not aligned to requested alignment
 	}
 	else {
+		zloc__record_trace(allocator, zloc_trace_op_allocate_aligned, 0, 0, size, alignment);
+		zloc__unlock_thread_access(allocator);
+		return 0;
+	}
+	if (!zloc__tag_has_room(allocator, tag, zloc__do_size_class_callback(block))) {
+		zloc__return_block(allocator, block);
+		zloc__record_trace(allocator, zloc_trace_op_allocate_aligned, 0, 0, size, alignment);
 		zloc__unlock_thread_access(allocator);
 		return 0;
 	}
 
+	zloc__count_allocation(allocator, block);
+	zloc__tag_allocation(allocator, block, tag);
+	zloc__unpoison_allocation(allocator, block);
+	zloc__record_trace(allocator, zloc_trace_op_allocate_aligned, 0, zloc__block_user_ptr(block), size, alignment);
 	zloc__unlock_thread_access(allocator);
 	return zloc__block_user_ptr(block);
 }
 
-int zloc_Free(zloc_allocator *allocator, void* allocation) {
-	if (!allocation) return 0;
+#ifdef ZLOC_ENABLE_QUARANTINE
+#define zloc__quarantine_next(block) (*(zloc_header**)zloc__block_user_ptr(block))
+
+//Check the poison is still intact and then really free the block
+static void zloc__release_quarantined_block(zloc_allocator *allocator, zloc_header *block) {
+	zloc_size size = zloc__block_size(block);
+	unsigned char *allocation = (unsigned char*)zloc__block_user_ptr(block);
+	zloc__unpoison_memory(allocation, size);
+	zloc_size poison;
+	memset(&poison, ZLOC_QUARANTINE_POISON, sizeof(zloc_size));
+	//Block sizes are always a multiple of the word size so check a word at a time, skipping the quarantine link
+	for (zloc_size i = sizeof(zloc_header*); i < size; i += sizeof(zloc_size)) {
+		if (*(zloc_size*)(allocation + i) != poison) {
+			while (allocation[i] == (unsigned char)ZLOC_QUARANTINE_POISON) ++i;
+			ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Allocation at %p was written to after it was freed (%zu bytes in).\n", ZLOC_ERROR_NAME, (void*)allocation, (size_t)i);
+			if (allocator->use_after_free_callback) {
+				allocator->use_after_free_callback(allocator->quarantine_user_data, allocation, size, i);
+			}
+			break;
+		}
+	}
+	allocator->quarantine_bytes -= size;
+	zloc__free_block(allocator, block);
+}
+
+static void zloc__evict_quarantine(zloc_allocator *allocator, zloc_size max_bytes) {
+	while (allocator->quarantine_head && allocator->quarantine_bytes > max_bytes) {
+		zloc_header *block = allocator->quarantine_head;
+		allocator->quarantine_head = zloc__quarantine_next(block);
+		if (!allocator->quarantine_head) {
+			allocator->quarantine_tail = 0;
+		}
+		zloc__release_quarantined_block(allocator, block);
+	}
+}
+
+/*
+	Instead of freeing the block straight away, poison it and hold on to it at the back of the quarantine. The block
+	stays marked as used so nothing can merge with it until it's evicted from the front.
+*/
+static void zloc__quarantine_block(zloc_allocator *allocator, zloc_header *block) {
+	zloc_size size = zloc__block_size(block);
+	if (size > allocator->quarantine_size) {
+		zloc__free_block(allocator, block);
+		return;
+	}
+	memset(zloc__block_user_ptr(block), ZLOC_QUARANTINE_POISON, size);
+	//With a sanitizer any access to the block while it's in quarantine is caught straight away
+	zloc__poison_memory((char*)zloc__block_user_ptr(block) + zloc__POINTER_SIZE, size - zloc__POINTER_SIZE);
+	zloc__quarantine_next(block) = 0;
+	if (allocator->quarantine_tail) {
+		zloc__quarantine_next(allocator->quarantine_tail) = block;
+	} else {
+		allocator->quarantine_head = block;
+	}
+	allocator->quarantine_tail = block;
+	allocator->quarantine_bytes += size;
+	zloc__evict_quarantine(allocator, allocator->quarantine_size);
+}
+
+/*
+	Set the most bytes that freed blocks can be held in quarantine for. Anything over the new size is evicted straight
+	away and 0 switches the quarantine off.
+*/
+void zloc_SetQuarantineSize(zloc_allocator *allocator, zloc_size bytes) {
+	ZLOC_ASSERT(allocator->get_block_size_callback == zloc__block_size);	//Remote memory can't be poisoned
+	zloc__lock_thread_access(allocator);
+	allocator->quarantine_size = bytes;
+	zloc__evict_quarantine(allocator, bytes);
+	zloc__unlock_thread_access(allocator);
+}
+
+//Check and free everything in the quarantine
+void zloc_FlushQuarantine(zloc_allocator *allocator) {
+	zloc__lock_thread_access(allocator);
+	zloc__evict_quarantine(allocator, 0);
+	zloc__unlock_thread_access(allocator);
+}
+
+void zloc_SetUseAfterFreeCallback(zloc_allocator *allocator, zloc_use_after_free_callback callback, void *user_data) {
+	zloc__lock_thread_access(allocator);
+	allocator->use_after_free_callback = callback;
+	allocator->quarantine_user_data = user_data;
+	zloc__unlock_thread_access(allocator);
+}
+#endif
+
+#ifdef ZLOC_ENABLE_HEADER_CHECKSUMS
+/*
+	Check every header that freeing a block is going to touch: the block itself, the next block (including that it
+	still points back to this one) and the previous block if it's free and going to be merged.
+*/
+static inline zloc__no_sanitize zloc_bool zloc__block_headers_are_intact(const zloc_header *block) {
+	if (!zloc__header_is_intact(block)) {
+		return 0;
+	}
+	const zloc_header *next_block = zloc__next_physical_block(block);
+	if (!zloc__header_is_intact(next_block)) {
+		return 0;
+	}
+	if (next_block->prev_physical_block != block) {
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: The header of the block at %p has been written over.\n", ZLOC_ERROR_NAME, (void*)next_block);
+		ZLOC_HEADER_CORRUPTED(next_block);
+		return 0;
+	}
+	return !zloc__prev_is_free_block(block) || zloc__header_is_intact(block->prev_physical_block);
+}
+#endif
+
+static zloc__no_sanitize int zloc__free(zloc_allocator *allocator, void* allocation) {
 	zloc__lock_thread_access(allocator);
 	zloc_header *block = zloc__block_from_allocation(allocation);
 	#ifdef ZLOC_SAFEGUARDS
 	//Asserting here means that there's probably been a mix up between a context allocator and a device allocator.
 	ZLOC_ASSERT(block->allocator == allocator);
 	#endif
-	if (zloc__prev_is_free_block(block)) {
-		ZLOC_ASSERT(block->prev_physical_block);		//Must be a valid previous physical block
-		block = zloc__merge_with_prev_block(allocator, block);
+	#ifdef ZLOC_ENABLE_HEADER_CHECKSUMS
+	if (!zloc__block_headers_are_intact(block)) {
+		//Leave the block where it is rather then spread the damage into the free lists
+		zloc__unlock_thread_access(allocator);
+		return 0;
 	}
-	if (zloc__next_block_is_free(block)) {
-		zloc__merge_with_next_block(allocator, block);
+	#endif
+	zloc__record_trace(allocator, zloc_trace_op_free, allocation, 0, 0, 0);
+	#ifdef ZLOC_ENABLE_QUARANTINE
+	if (allocator->quarantine_size) {
+		zloc__quarantine_block(allocator, block);
+		zloc__unlock_thread_access(allocator);
+		return 1;
 	}
-	zloc__push_block(allocator, block);
+	#endif
+	zloc__free_block(allocator, block);
 	zloc__unlock_thread_access(allocator);
 	return 1;
 }
 
-ZLOC_API void* zloc_PromoteLinearBlock(zloc_allocator *allocator, void* linear_alloc_mem, zloc_size used_size) {
+#if defined(ZLOC_ENABLE_GUARD_PAGES) || defined(ZLOC_ENABLE_NUMA) || defined(ZLOC_ENABLE_ZERO_TRACKING)
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+//Define ZLOC_GUARD_PAGE_SIZE if you'd rather not ask the OS every time
+static inline zloc_size zloc__page_size(void) {
+	#if defined(ZLOC_GUARD_PAGE_SIZE)
+	return ZLOC_GUARD_PAGE_SIZE;
+	#elif defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (zloc_size)info.dwPageSize;
+	#else
+	return (zloc_size)sysconf(_SC_PAGESIZE);
+	#endif
+}
+#endif
+
+#ifdef ZLOC_ENABLE_ZERO_TRACKING
+//Hand whole pages back to the OS so that they're zero the next time they're touched. Returns 0 if that's not possible.
+static inline zloc_bool zloc__release_pages(void *memory, zloc_size size) {
+	#if defined(_WIN32)
+	return VirtualFree(memory, size, MEM_DECOMMIT) && VirtualAlloc(memory, size, MEM_COMMIT, PAGE_READWRITE) != 0;
+	#elif defined(__linux__) && defined(MADV_DONTNEED)
+	return madvise(memory, size, MADV_DONTNEED) == 0;
+	#else
+	return 0;
+	#endif
+}
+
+/*
+	Give the pages in every free block back to the OS and mark the blocks as zero so that zloc_AllocateZeroed doesn't
+	need to clear them. Whole pages are released with madvise(MADV_DONTNEED) on Linux or decommitted and committed again
+	on Windows, and whatever is left at either end of a block is cleared with memset. Anywhere else, or if the pages
+	can't be released, the blocks are just cleared. Pools need to be private anonymous memory (mmap, VirtualAlloc or
+	malloc) for this, released pages of a file or shared mapping won't come back as zero. Returns the number of bytes
+	given back to the OS.
+*/
+zloc__no_sanitize zloc_size zloc_PurgeFreeMemory(zloc_allocator *allocator) {
+	ZLOC_ASSERT(allocator->get_block_size_callback == zloc__block_size);	//Remote memory can't be purged
+	zloc__lock_thread_access(allocator);
+	zloc_size page_size = zloc__page_size();
+	zloc_size released = 0;
+	for (zloc_index fli = 0; fli != zloc__FIRST_LEVEL_INDEX_COUNT; ++fli) {
+		for (zloc_index sli = 0; sli != zloc__SECOND_LEVEL_INDEX_COUNT; ++sli) {
+			for (zloc_header *block = allocator->segregated_lists[fli][sli]; block != zloc__null_block(allocator); block = block->next_free_block) {
+				//The free list pointers have to stay
+				char *start = (char*)zloc__block_user_ptr(block) + zloc__POINTER_SIZE * 2;
+				char *end = (char*)zloc__block_user_ptr(block) + zloc__block_size(block);
+				char *first_page = (char*)zloc__align_size_up((zloc_size)(uintptr_t)start, page_size);
+				char *last_page = (char*)zloc__align_size_down((zloc_size)(uintptr_t)end, page_size);
+				zloc__unpoison_memory(start, end - start);
+				if (first_page < last_page && zloc__release_pages(first_page, last_page - first_page)) {
+					released += last_page - first_page;
+					if (!zloc__zero_flag(block)) {
+						memset(start, 0, first_page - start);
+						memset(last_page, 0, end - last_page);
+					}
+				}
+				else if (!zloc__zero_flag(block)) {
+					memset(start, 0, end - start);
+				}
+				zloc__set_zero_flag(block, zloc__BLOCK_IS_ZERO);
+				zloc__poison_free_block(allocator, block);
+			}
+		}
+	}
+	zloc__unlock_thread_access(allocator);
+	return released;
+}
+#endif
+
+#ifdef ZLOC_ENABLE_GUARD_PAGES
+#define zloc__GUARD_MAGIC ((zloc_size)0x5A4C4F47)
+
+//Sits just before a guarded allocation so that it can be found again when it's freed
+typedef struct zloc__guard_info {
+	void *allocation;		//The page aligned allocation from the pool that holds it all
+	zloc_size size;
+	zloc_size magic;
+} zloc__guard_info;
+
+static inline zloc_bool zloc__protect_guard_page(void *page, zloc_size page_size, zloc_bool no_access) {
+	#ifdef _WIN32
+	DWORD old_protection;
+	return VirtualProtect(page, page_size, no_access ? PAGE_NOACCESS : PAGE_READWRITE, &old_protection) != 0;
+	#else
+	return mprotect(page, page_size, no_access ? PROT_NONE : PROT_READ | PROT_WRITE) == 0;
+	#endif
+}
+
+/*
+	Take a page aligned span from the pool that's big enough for the allocation plus one extra page, make the last
+	page inaccessible and put the allocation right up against it. Writing past the end of the allocation then faults
+	straight away. The allocation is only aligned to the alignment asked for (or zloc__MEMORY_ALIGNMENT) so an overrun
+	smaller then that won't reach the guard page. The span is charged to the tag.
+*/
+static void *zloc__allocate_guarded(zloc_allocator *allocator, zloc_size size, zloc_size alignment, zloc_uint tag) {
+	ZLOC_ASSERT(allocator->get_block_size_callback == zloc__block_size);	//Guard pages don't work with remote memory
+	zloc_size page_size = zloc__page_size();
+	alignment = zloc__Max(alignment, zloc__MEMORY_ALIGNMENT);
+	ZLOC_ASSERT(alignment <= page_size);	//Can't align guarded allocations to more then a page
+	zloc_size span = zloc__align_size_up(size + sizeof(zloc__guard_info) + alignment, page_size) + page_size;
+	char *allocation = (char*)zloc__allocate_aligned(allocator, span, page_size, tag);
+	if (!allocation) {
+		return 0;
+	}
+	char *guard_page = allocation + span - page_size;
+	char *ptr = (char*)((uintptr_t)(guard_page - size) & ~(uintptr_t)(alignment - 1));
+	zloc__guard_info *info = (zloc__guard_info*)ptr - 1;
+	info->allocation = allocation;
+	info->size = size;
+	info->magic = zloc__GUARD_MAGIC;
+	if (!zloc__protect_guard_page(guard_page, page_size, 1)) {
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Unable to protect the guard page of an allocation, is the pool memory page aligned memory from the OS?\n", ZLOC_ERROR_NAME);
+		zloc__free(allocator, allocation);
+		return 0;
+	}
+	return ptr;
+}
+
+static int zloc__free_guarded(zloc_allocator *allocator, void *ptr) {
+	zloc__guard_info *info = (zloc__guard_info*)ptr - 1;
+	//If this fires then either the allocation wasn't guarded or something wrote over the memory just before it
+	ZLOC_ASSERT(info->magic == zloc__GUARD_MAGIC);
+	zloc_size page_size = zloc__page_size();
+	void *guard_page = (void*)zloc__align_size_up((zloc_size)(uintptr_t)ptr + info->size, page_size);
+	//The memory has to be accessible again before it goes back in the free lists
+	zloc__protect_guard_page(guard_page, page_size, 0);
+	info->magic = 0;
+	return zloc__free(allocator, info->allocation);
+}
+
+//Always moves, which also helps catch anything still holding on to the old pointer
+static void *zloc__reallocate_guarded(zloc_allocator *allocator, void *ptr, zloc_size size, zloc_bool zeroed) {
+	zloc_size kept_size = ptr ? zloc__Min(size, ((zloc__guard_info*)ptr - 1)->size) : 0;
+	if (ptr && !size) {
+		zloc__free_guarded(allocator, ptr);
+		return 0;
+	}
+	zloc_uint tag = ptr ? zloc__block_tag(zloc__block_from_allocation(((zloc__guard_info*)ptr - 1)->allocation)) : 0;
+	void *allocation = zloc__allocate_guarded(allocator, size, 0, tag);
+	if (allocation && ptr) {
+		zloc__copy_memory(allocation, ptr, kept_size);
+		zloc__free_guarded(allocator, ptr);
+	}
+	if (allocation && zeroed) {
+		memset((char*)allocation + kept_size, 0, size - kept_size);
+	}
+	return allocation;
+}
+
+void *zloc_AllocateGuarded(zloc_allocator *allocator, zloc_size size, zloc_size alignment) {
+	return zloc__allocate_guarded(allocator, size, alignment, 0);
+}
+
+int zloc_FreeGuarded(zloc_allocator *allocator, void *allocation) {
+	return allocation ? zloc__free_guarded(allocator, allocation) : 0;
+}
+
+/*
+	Turn on guard page mode, where every zloc_Allocate, zloc_AllocateZeroed, zloc_AllocateSizeReturning,
+	zloc_AllocateTagged, zloc_AllocateAligned and zloc_Reallocate is guarded and zloc_Free expects guarded allocations.
+	Switch it on before making any allocations. Other allocation functions (zloc_UsableSize, zloc_Shrink and so on)
+	don't know about guarded allocations so don't mix them in.
+*/
+void zloc_SetGuardPages(zloc_allocator *allocator, zloc_bool enabled) {
+	allocator->guard_pages = enabled;
+}
+#endif
+
+void *zloc_AllocateAligned(zloc_allocator *allocator, zloc_size size, zloc_size alignment) {
+	#ifdef ZLOC_ENABLE_GUARD_PAGES
+	if (allocator->guard_pages) {
+		return zloc__allocate_guarded(allocator, size, alignment, 0);
+	}
+	#endif
+	return zloc__allocate_aligned(allocator, size, alignment, 0);
+}
+
+int zloc_Free(zloc_allocator *allocator, void* allocation) {
+	if (!allocation) return 0;
+	#ifdef ZLOC_ENABLE_GUARD_PAGES
+	if (allocator->guard_pages) {
+		return zloc__free_guarded(allocator, allocation);
+	}
+	#endif
+	return zloc__free(allocator, allocation);
+}
+
+ZLOC_API zloc__no_sanitize void* zloc_PromoteLinearBlock(zloc_allocator *allocator, void* linear_alloc_mem, zloc_size used_size) {
 	if (!allocator || !linear_alloc_mem || used_size == 0) {
 		return 0;
 	}
@@ -1143,13 +2884,16 @@ ZLOC_API void* zloc_PromoteLinearBlock(zloc_allocator *allocator, void* linear_a
 
 	allocator->stats.blocks_in_use++;
 	zloc__push_block(allocator, trimmed_free_block);
+	zloc__count_resize(allocator, original_block_size, block);
+	zloc__tag_resize(allocator, original_block_size, block);
+	zloc__unpoison_allocation(allocator, block);
 
 	zloc__unlock_thread_access(allocator);
 
 	return linear_alloc_mem;
 }
 
-int zloc_SafeCopy(void *dst, void *src, zloc_size size) {
+zloc__no_sanitize int zloc_SafeCopy(void *dst, void *src, zloc_size size) {
 	zloc_header *block = zloc__block_from_allocation(dst);
 	if (size > block->size) {
 		assert(0);  //Trying to copy outside of the memory block
@@ -1184,7 +2928,7 @@ int zloc_SafeCopyBlock(void *dst_block_start, void *dst, const void *src, zloc_s
 //  - the terminating sentinel has size 0 and points back at the last real block
 //Use alongside zloc__verify_lists for the most thorough corruption check. The pool argument is the
 //pointer originally returned from zloc_AddPool / zloc_GetPool.
-void zloc_VerifyPool(zloc_allocator *allocator, const zloc_pool *pool) {
+zloc__no_sanitize void zloc_VerifyPool(zloc_allocator *allocator, const zloc_pool *pool) {
 	zloc_header *block = zloc__first_block_in_pool(pool);
 	zloc_header *prev = 0;
 	int safety = 0;
@@ -1222,6 +2966,102 @@ void zloc_VerifyPool(zloc_allocator *allocator, const zloc_pool *pool) {
 	}
 }
 
+/*
+	Start verifying a pool a few blocks at a time with zloc_VerifyStep. The allocator keeps hold of the cursor so that
+	it can keep it pointing at a valid block, so there can only be one cursor per allocator. Initialising another one
+	replaces it. Call zloc_ReleaseVerifyCursor before the cursor goes out of scope.
+*/
+void zloc_InitialiseVerifyCursor(zloc_allocator *allocator, zloc_verify_cursor *cursor, const zloc_pool *pool) {
+	zloc__lock_thread_access(allocator);
+	memset(cursor, 0, sizeof(zloc_verify_cursor));
+	cursor->pool = pool;
+	cursor->block = zloc__first_block_in_pool(pool);
+	allocator->verify_cursor = cursor;
+	zloc__unlock_thread_access(allocator);
+}
+
+//Stop the allocator keeping the cursor up to date. Steps after this return zloc_verify_pass_complete straight away.
+void zloc_ReleaseVerifyCursor(zloc_allocator *allocator, zloc_verify_cursor *cursor) {
+	zloc__lock_thread_access(allocator);
+	if (allocator->verify_cursor == cursor) {
+		allocator->verify_cursor = 0;
+	}
+	cursor->pool = 0;
+	cursor->block = 0;
+	zloc__unlock_thread_access(allocator);
+}
+
+/*
+	Check up to block_budget blocks of the pool, carrying on from where the last step finished. Each block is checked
+	against the block after it, the same as zloc_VerifyPool, but it returns what it found instead of asserting. The
+	allocator is only locked for the length of the step so call it from a housekeeping thread with a small budget to
+	keep checking the heap without holding up allocations. When a check fails, bad_block is set and the next step
+	starts from the beginning of the pool again.
+*/
+zloc__no_sanitize zloc_verify_result zloc_VerifyStep(zloc_allocator *allocator, zloc_verify_cursor *cursor, zloc_size block_budget) {
+	//Checked with the lock held so that the pool can't be removed by another thread after the check
+	zloc__lock_thread_access(allocator);
+	if (!cursor->pool) {
+		//The pool was removed
+		zloc__unlock_thread_access(allocator);
+		return zloc_verify_pass_complete;
+	}
+	ZLOC_ASSERT(allocator->verify_cursor == cursor);	//Another cursor has been initialised since this one
+	zloc_verify_result result = zloc_verify_in_progress;
+	zloc_header *first_block = zloc__first_block_in_pool(cursor->pool);
+	zloc_header *block = cursor->block;
+	cursor->bad_block = 0;
+	while (block_budget--) {
+		if (block == first_block && zloc__prev_is_free_block(block)) {
+			result = zloc_verify_bad_first_block;
+			break;
+		}
+		#ifdef ZLOC_ENABLE_HEADER_CHECKSUMS
+		if (block->checksum != zloc__header_checksum(block)) {
+			result = zloc_verify_bad_checksum;
+			break;
+		}
+		#endif
+		if (zloc__is_last_block_in_pool(block)) {
+			result = zloc__is_used_block(block) ? zloc_verify_pass_complete : zloc_verify_bad_sentinel;
+			break;
+		}
+		if (!zloc__is_aligned(zloc__block_size(block), zloc__MEMORY_ALIGNMENT)) {
+			result = zloc_verify_misaligned_size;
+			break;
+		}
+		zloc_header *next_block = zloc__next_physical_block(block);
+		if (next_block->prev_physical_block != block) {
+			result = zloc_verify_broken_link;
+			break;
+		}
+		zloc_bool is_free = zloc__is_free_block(block);
+		if (is_free != (zloc__prev_is_free_block(next_block) != 0)) {
+			result = zloc_verify_boundary_tag_mismatch;
+			break;
+		}
+		if (is_free && zloc__is_free_block(next_block)) {
+			result = zloc_verify_adjacent_free_blocks;
+			break;
+		}
+		cursor->blocks_checked++;
+		block = next_block;
+	}
+	if (result == zloc_verify_in_progress) {
+		cursor->block = block;
+	} else {
+		if (result == zloc_verify_pass_complete) {
+			cursor->passes++;
+		} else {
+			cursor->bad_block = block;
+		}
+		cursor->block = first_block;
+		cursor->blocks_checked = 0;
+	}
+	zloc__unlock_thread_access(allocator);
+	return result;
+}
+
 zloc_pool_stats_t zloc_CreateMemorySnapshot(const zloc_pool *pool) {
 	zloc_pool_stats_t stats = { 0 };
 	zloc_header *current_block = zloc__first_block_in_pool(pool);;
@@ -1245,48 +3085,1100 @@ zloc_pool_stats_t zloc_CreateMemorySnapshot(const zloc_pool *pool) {
 	return stats;
 }
 
-/*
-	Standard callbacks, you can copy paste these to replace with your own as needed to add any extra functionality
-	that you might need
-*/
-void zloc__remote_merge_next_callback(void *remote_user_data, zloc_header *block, zloc_header *next_block) {
-	zloc_remote_header *remote_block = (zloc_remote_header*)zloc_BlockUserExtensionPtr(block);
-	zloc_remote_header *next_remote_block = (zloc_remote_header*)zloc_BlockUserExtensionPtr(next_block);
-	remote_block->size += next_remote_block->size;
-	next_remote_block->memory_offset = 0;
-	next_remote_block->size = 0;
+#ifdef ZLOC_ENABLE_CLASS_STATS
+//Read the counters for one size class. Safe to call from any thread without locking the allocator, each counter is
+//read atomically but they're not a consistent snapshot of each other.
+zloc_class_stats zloc_GetClassStats(const zloc_allocator *allocator, zloc_index fli, zloc_index sli) {
+	ZLOC_ASSERT(fli >= 0 && fli < zloc__FIRST_LEVEL_INDEX_COUNT && sli >= 0 && sli < zloc__SECOND_LEVEL_INDEX_COUNT);
+	const zloc_class_stats *counters = &allocator->class_stats[fli][sli];
+	zloc_class_stats stats;
+	stats.allocations = zloc__stat_read(counters->allocations);
+	stats.frees = zloc__stat_read(counters->frees);
+	stats.live_bytes = zloc__stat_read(counters->live_bytes);
+	stats.splits = zloc__stat_read(counters->splits);
+	stats.merges = zloc__stat_read(counters->merges);
+	stats.escalations = zloc__stat_read(counters->escalations);
+	return stats;
 }
 
-void zloc__remote_merge_prev_callback(void *remote_user_data, zloc_header *prev_block, zloc_header *block) {
-	zloc_remote_header *remote_block = (zloc_remote_header*)zloc_BlockUserExtensionPtr(block);
-	zloc_remote_header *prev_remote_block = (zloc_remote_header*)zloc_BlockUserExtensionPtr(prev_block);
-	prev_remote_block->size += remote_block->size;
-	remote_block->memory_offset = 0;
-	remote_block->size = 0;
+void zloc_GetAllClassStats(const zloc_allocator *allocator, zloc_class_stats stats[zloc__FIRST_LEVEL_INDEX_COUNT][zloc__SECOND_LEVEL_INDEX_COUNT]) {
+	for (zloc_index fli = 0; fli != zloc__FIRST_LEVEL_INDEX_COUNT; ++fli) {
+		for (zloc_index sli = 0; sli != zloc__SECOND_LEVEL_INDEX_COUNT; ++sli) {
+			stats[fli][sli] = zloc_GetClassStats(allocator, fli, sli);
+		}
+	}
 }
 
-zloc_size zloc__get_remote_size(const zloc_header *block) {
-	zloc_remote_header *remote_block = (zloc_remote_header*)zloc_BlockUserExtensionPtr(block);
-	return remote_block->size;
+//The smallest block size that maps to a size class, handy for labelling the classes when exporting the stats
+zloc_size zloc_ClassMinimumSize(zloc_index fli, zloc_index sli) {
+	if (fli == 0) {
+		return (zloc_size)sli * (zloc__SMALLEST_CATEGORY / zloc__SECOND_LEVEL_INDEX_COUNT);
+	}
+	return (ZLOC_ONE << fli) + ((zloc_size)sli << (fli - zloc__SECOND_LEVEL_INDEX_LOG2));
 }
+#endif
 
-void *zloc_Allocate(zloc_allocator *allocator, zloc_size size) {
-	return zloc__allocate(allocator, size, 0);
+#ifdef ZLOC_ENABLE_TAGGING
+/*
+	Allocate and tag the allocation with the subsystem that owns it. The allocation counts towards the tag's live bytes
+	until it's freed and keeps its tag if it's reallocated. Untagged allocations have tag 0.
+*/
+void *zloc_AllocateTagged(zloc_allocator *allocator, zloc_size size, zloc_uint tag) {
+	if (tag >= ZLOC_MAX_TAGS) {
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Tag %u is out of range, increase ZLOC_MAX_TAGS.\n", ZLOC_ERROR_NAME, tag);
+		return 0;
+	}
+	#ifdef ZLOC_ENABLE_GUARD_PAGES
+	if (allocator->guard_pages) {
+		return zloc__allocate_guarded(allocator, size, 0, tag);
+	}
+	#endif
+	return zloc__allocate(allocator, size, 0, tag, 0);
 }
 
-void zloc_SetBlockExtensionSize(zloc_allocator *allocator, zloc_size size) {
-	ZLOC_ASSERT(allocator->block_extension_size == 0);	//You cannot change this once set
-	allocator->block_extension_size = zloc__align_size_up(size, zloc__MEMORY_ALIGNMENT);
+zloc_uint zloc_GetAllocationTag(const void *allocation) {
+	return zloc__block_tag(zloc__block_from_allocation(allocation));
 }
 
-zloc_size zloc_CalculateRemoteBlockPoolSize(zloc_allocator *allocator, zloc_size remote_pool_size) {
-	ZLOC_ASSERT(allocator->block_extension_size);	//You must set the block extension size first
-	ZLOC_ASSERT(allocator->minimum_allocation_size);		//You must set the number of bytes per block
-	return (sizeof(zloc_header) + allocator->block_extension_size) * (remote_pool_size / allocator->minimum_allocation_size) + zloc__BLOCK_POINTER_OFFSET;
+//Total size of the blocks in use with a tag. Safe to call from any thread without locking the allocator.
+zloc_size zloc_GetTagLiveBytes(const zloc_allocator *allocator, zloc_uint tag) {
+	if (tag >= ZLOC_MAX_TAGS) {
+		return 0;
+	}
+	return zloc__stat_read(allocator->tag_live_bytes[tag]);
 }
 
-void zloc_AddRemotePool(zloc_allocator *allocator, void *block_memory, zloc_size block_memory_size, zloc_size remote_pool_size) {
-	ZLOC_ASSERT(allocator->add_pool_callback);	//You must set all the necessary callbacks to handle remote memory management
+//Cap the bytes a tag can have in use at once, allocations that would go over fail. Pass 0 to remove the cap.
+void zloc_SetTagBudget(zloc_allocator *allocator, zloc_uint tag, zloc_size budget) {
+	ZLOC_ASSERT(tag < ZLOC_MAX_TAGS);	//Tag is out of range, increase ZLOC_MAX_TAGS
+	if (tag >= ZLOC_MAX_TAGS) {
+		return;
+	}
+	zloc__lock_thread_access(allocator);
+	allocator->tag_budgets[tag] = budget;
+	zloc__unlock_thread_access(allocator);
+}
+
+void zloc_SetTagOverBudgetCallback(zloc_allocator *allocator, zloc_tag_over_budget_callback callback, void *user_data) {
+	zloc__lock_thread_access(allocator);
+	allocator->tag_over_budget_callback = callback;
+	allocator->tag_user_data = user_data;
+	zloc__unlock_thread_access(allocator);
+}
+#endif
+
+#ifdef ZLOC_ENABLE_TRACING
+void zloc_InitialiseTraceBuffer(zloc_trace_buffer *trace, zloc_trace_event *events, zloc_size capacity) {
+	ZLOC_ASSERT(events && capacity);	//Trace buffer needs some memory to record into
+	memset(trace, 0, sizeof(zloc_trace_buffer));
+	trace->events = events;
+	trace->capacity = capacity;
+}
+
+//The callback is called whenever the buffer fills up and on zloc_FlushTraceBuffer. It's called from inside the
+//allocator so it must not call back into the allocator that's being traced.
+void zloc_SetTraceFlushCallback(zloc_trace_buffer *trace, zloc_trace_flush_callback callback, void *user_data) {
+	trace->flush_callback = callback;
+	trace->user_data = user_data;
+}
+
+//Start (or with 0, stop) recording every allocate, free, reallocate and aligned allocate into the trace buffer. One
+//trace buffer can be shared by more then one allocator.
+void zloc_SetTraceBuffer(zloc_allocator *allocator, zloc_trace_buffer *trace) {
+	zloc__lock_thread_access(allocator);
+	allocator->trace = trace;
+	zloc__unlock_thread_access(allocator);
+}
+
+//Copy the events currently in the buffer, oldest first, without removing them. Returns the number copied.
+zloc_size zloc_GetTraceEvents(zloc_trace_buffer *trace, zloc_trace_event *events, zloc_size max_events) {
+	zloc__lock_thread_access(trace);
+	zloc_size count = zloc__Min(trace->count, max_events);
+	for (zloc_size i = 0; i != count; ++i) {
+		events[i] = trace->events[(trace->start + i) % trace->capacity];
+	}
+	zloc__unlock_thread_access(trace);
+	return count;
+}
+
+//Hand everything in the buffer to the flush callback and empty it. Call this before closing a trace file.
+void zloc_FlushTraceBuffer(zloc_trace_buffer *trace) {
+	zloc__lock_thread_access(trace);
+	if (trace->flush_callback) {
+		zloc__flush_trace(trace);
+	}
+	zloc__unlock_thread_access(trace);
+}
+
+zloc_bool zloc_WriteTraceFileHeader(FILE *file, const zloc_allocator *allocator) {
+	zloc_trace_file_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ZLOC_TRACE_FILE_MAGIC, sizeof(header.magic));
+	header.version = ZLOC_TRACE_FILE_VERSION;
+	header.event_size = sizeof(zloc_trace_event);
+	header.minimum_allocation_size = allocator->minimum_allocation_size;
+	header.max_size_index = ZLOC_MAX_SIZE_INDEX;
+	return fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+//A flush callback that appends the events to a FILE*. Pass the file as the user data.
+void zloc_TraceFileFlushCallback(void *file, const zloc_trace_event *events, zloc_size count) {
+	if (fwrite(events, sizeof(zloc_trace_event), count, (FILE*)file) != count) {
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Unable to write %zu trace events to file\n", ZLOC_ERROR_NAME, count);
+	}
+}
+#endif
+
+#ifdef ZLOC_ENABLE_SAMPLING
+//Take a backtrace roughly once every sample_rate bytes allocated. Smaller rates give more detail but cost more.
+void zloc_InitialiseSampler(zloc_sampler *sampler, zloc_size sample_rate) {
+	ZLOC_ASSERT(sample_rate);	//Sample rate must be at least 1 byte
+	memset(sampler, 0, sizeof(zloc_sampler));
+	sampler->sample_rate = sample_rate;
+	sampler->random_state = 0x9E3779B97F4A7C15ull;
+}
+
+//Start (or with 0, stop) sampling the allocations made with zloc_Allocate, zloc_AllocateTagged and
+//zloc_AllocateRemote. One sampler can be shared by more then one allocator. Samples are recorded after the allocator
+//is unlocked so keep the sampler around until other threads have stopped allocating, not just until this returns.
+void zloc_SetSampler(zloc_allocator *allocator, zloc_sampler *sampler) {
+	zloc__lock_thread_access(allocator);
+	allocator->sampler = sampler;
+	if (sampler) {
+		zloc__lock_thread_access(sampler);
+		allocator->bytes_until_sample = zloc__next_sample_interval(sampler);
+		zloc__unlock_thread_access(sampler);
+	}
+	zloc__unlock_thread_access(allocator);
+}
+
+void zloc_ResetSampler(zloc_sampler *sampler) {
+	zloc__lock_thread_access(sampler);
+	memset(sampler->callsites, 0, sizeof(sampler->callsites));
+	sampler->callsite_count = 0;
+	sampler->samples = 0;
+	sampler->dropped = 0;
+	zloc__unlock_thread_access(sampler);
+}
+
+//Copy out up to max_callsites of the sampled callsites with the most estimated bytes first. Returns the number copied.
+zloc_size zloc_GetSampledCallsites(zloc_sampler *sampler, zloc_sample_callsite *callsites, zloc_size max_callsites) {
+	zloc_size count = 0;
+	zloc__lock_thread_access(sampler);
+	for (zloc_size i = 0; i != ZLOC_SAMPLE_CALLSITES && max_callsites; ++i) {
+		const zloc_sample_callsite *callsite = &sampler->callsites[i];
+		if (!callsite->samples || (count == max_callsites && callsite->estimated_bytes <= callsites[count - 1].estimated_bytes)) {
+			continue;
+		}
+		//Insertion sort, the smallest drops off the end once the output is full
+		zloc_size position = count < max_callsites ? count++ : count - 1;
+		while (position > 0 && callsites[position - 1].estimated_bytes < callsite->estimated_bytes) {
+			callsites[position] = callsites[position - 1];
+			position--;
+		}
+		callsites[position] = *callsite;
+	}
+	zloc__unlock_thread_access(sampler);
+	return count;
+}
+
+static void zloc__write_frame(FILE *file, void *frame, const char *symbol) {
+	//backtrace_symbols gives "module(function+offset) [address]", keep just the function if there is one
+	const char *name = symbol ? strchr(symbol, '(') : 0;
+	zloc_size length = 0;
+	if (name) {
+		name++;
+		while (name[length] && name[length] != '+' && name[length] != ')') {
+			length++;
+		}
+	}
+	if (length) {
+		fwrite(name, 1, length, file);
+	} else {
+		fprintf(file, "%p", frame);
+	}
+}
+
+/*
+	Write the sampled callsites in the folded stack format used by flamegraph.pl, inferno and speedscope: one line per
+	callsite with the frames outermost first separated by semicolons, then the estimated bytes allocated from there.
+	Frames are symbolised with backtrace_symbols where it's available (link with -rdynamic to get the names of non
+	static functions) and written as addresses otherwise.
+*/
+zloc_bool zloc_WriteFoldedStacks(zloc_sampler *sampler, FILE *file) {
+	zloc_bool result = 1;
+	for (zloc_size i = 0; i != ZLOC_SAMPLE_CALLSITES && result; ++i) {
+		//Copy each callsite out so that the sampler isn't locked while symbolising
+		zloc__lock_thread_access(sampler);
+		zloc_sample_callsite callsite = sampler->callsites[i];
+		zloc__unlock_thread_access(sampler);
+		if (!callsite.samples) {
+			continue;
+		}
+		char **symbols = 0;
+		#ifdef zloc__SAMPLE_SYMBOLS
+		symbols = backtrace_symbols(callsite.frames, (int)callsite.depth);
+		#endif
+		if (!callsite.depth) {
+			fputs("[unknown]", file);
+		}
+		for (zloc_size frame = callsite.depth; frame-- > 0;) {
+			zloc__write_frame(file, callsite.frames[frame], symbols ? symbols[frame] : 0);
+			if (frame) {
+				fputc(';', file);
+			}
+		}
+		result = fprintf(file, " %llu\n", (unsigned long long)callsite.estimated_bytes) > 0;
+		free(symbols);
+	}
+	return result;
+}
+#endif
+
+#define zloc__REGISTRY_NODE_MASK (((zloc_size)1 << ZLOC_REGISTRY_NODE_BITS) - 1)
+
+/*
+	Lookups don't take the registry lock, so anything a lookup can follow (nodes, leaves, slots and the next links
+	between records) is published with a release store once it's filled in and read with an acquire load. Other
+	compilers get plain loads and stores, so there lookups mustn't race with registering and unregistering.
+*/
+#if defined(ZLOC_THREAD_SAFE) && (defined(__GNUC__) || defined(__clang__))
+#define zloc__registry_load(pointer) __atomic_load_n(&(pointer), __ATOMIC_ACQUIRE)
+#define zloc__registry_store(pointer, value) __atomic_store_n(&(pointer), (value), __ATOMIC_RELEASE)
+#else
+#define zloc__registry_load(pointer) (pointer)
+#define zloc__registry_store(pointer, value) ((pointer) = (value))
+#endif
+
+//Carve zeroed memory for a node or record out of the registry's memory
+static void *zloc__registry_carve(zloc_pool_registry *registry, zloc_size size) {
+	zloc_size offset = zloc__align_size_up(registry->memory_used, sizeof(void*));
+	if (offset + size > registry->memory_size) {
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: The pool registry has run out of memory for its nodes.\n", ZLOC_ERROR_NAME);
+		return 0;
+	}
+	registry->memory_used = offset + size;
+	memset(registry->memory + offset, 0, size);
+	return registry->memory + offset;
+}
+
+//The slot for a granule, or 0 if there isn't one yet. With create set, missing nodes are added on the way down.
+static zloc_registered_pool **zloc__registry_slot(zloc_pool_registry *registry, zloc_size granule, zloc_bool create) {
+	zloc__registry_node **node = &registry->root[granule >> (2 * ZLOC_REGISTRY_NODE_BITS)];
+	if (!*node) {
+		zloc__registry_node *new_node = create ? (zloc__registry_node*)zloc__registry_carve(registry, sizeof(zloc__registry_node)) : 0;
+		if (!new_node) {
+			return 0;
+		}
+		zloc__registry_store(*node, new_node);
+	}
+	zloc__registry_leaf **leaf = &(*node)->leaves[(granule >> ZLOC_REGISTRY_NODE_BITS) & zloc__REGISTRY_NODE_MASK];
+	if (!*leaf) {
+		zloc__registry_leaf *new_leaf = create ? (zloc__registry_leaf*)zloc__registry_carve(registry, sizeof(zloc__registry_leaf)) : 0;
+		if (!new_leaf) {
+			return 0;
+		}
+		zloc__registry_store(*leaf, new_leaf);
+	}
+	return &(*leaf)->pools[granule & zloc__REGISTRY_NODE_MASK];
+}
+
+static inline zloc_bool zloc__registry_can_hold(zloc_size address) {
+	#if (defined(zloc__64BIT) && ZLOC_REGISTRY_ADDRESS_BITS < 64) || ZLOC_REGISTRY_ADDRESS_BITS < 32
+	return (address >> ZLOC_REGISTRY_ADDRESS_BITS) == 0;
+	#else
+	(void)address;
+	return 1;
+	#endif
+}
+
+//Three loads to get to the granule, then only the pools that share the granule are looked at
+static zloc_registered_pool *zloc__registry_find(const zloc_pool_registry *registry, zloc_size address) {
+	if (!zloc__registry_can_hold(address)) {
+		return 0;
+	}
+	zloc_size granule = address >> ZLOC_REGISTRY_GRANULE_LOG2;
+	const zloc__registry_node *node = zloc__registry_load(registry->root[granule >> (2 * ZLOC_REGISTRY_NODE_BITS)]);
+	if (!node) {
+		return 0;
+	}
+	const zloc__registry_leaf *leaf = zloc__registry_load(node->leaves[(granule >> ZLOC_REGISTRY_NODE_BITS) & zloc__REGISTRY_NODE_MASK]);
+	if (!leaf) {
+		return 0;
+	}
+	for (zloc_registered_pool *record = zloc__registry_load(leaf->pools[granule & zloc__REGISTRY_NODE_MASK]); record && record->start <= address; record = zloc__registry_load(record->next)) {
+		if (address < record->end) {
+			return record;
+		}
+	}
+	return 0;
+}
+
+/*
+	Each 1 << ZLOC_REGISTRY_GRANULE_LOG2 bytes (64KB by default) of address space that has a pool in it needs a slot in
+	a leaf node, and the leaf and node above it cover 1 << ZLOC_REGISTRY_NODE_BITS times more each. On 64bit with the
+	defaults that's 8KB for every 64MB range with pools in it and another 8KB for every 64GB range. Nodes are never
+	given back, even when pools are unregistered.
+*/
+void zloc_InitialisePoolRegistry(zloc_pool_registry *registry, void *memory, zloc_size size) {
+	memset(registry, 0, sizeof(zloc_pool_registry));
+	registry->memory = (char*)memory;
+	registry->memory_size = size;
+}
+
+/*
+	Pools can be any size and alignment and can share granules with each other, but they can't overlap. Pass the same
+	pool and size that you gave to zloc_AddPool, or zloc_GetPool(allocator) and the size minus zloc_AllocatorSize() for
+	the pool that came with zloc_InitialiseAllocatorWithPool.
+*/
+zloc_bool zloc_RegisterPool(zloc_pool_registry *registry, zloc_allocator *allocator, zloc_pool *pool, zloc_size size) {
+	zloc_size start = (zloc_size)(uintptr_t)pool;
+	zloc_size end = start + size;
+	if (!size || !zloc__registry_can_hold(end - 1)) {
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Tried to register a pool that's empty or beyond ZLOC_REGISTRY_ADDRESS_BITS.\n", ZLOC_ERROR_NAME);
+		return 0;
+	}
+	zloc__lock_thread_access(registry);
+	zloc_registered_pool *prev = 0;
+	zloc_registered_pool *next = registry->first;
+	while (next && next->start < start) {
+		prev = next;
+		next = next->next;
+	}
+	if ((prev && prev->end > start) || (next && next->start < end)) {
+		zloc__unlock_thread_access(registry);
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Tried to register a pool that overlaps one that's already registered.\n", ZLOC_ERROR_NAME);
+		return 0;
+	}
+	zloc_registered_pool *record = registry->free_records;
+	if (record) {
+		registry->free_records = record->next;
+	} else {
+		record = (zloc_registered_pool*)zloc__registry_carve(registry, sizeof(zloc_registered_pool));
+	}
+	zloc_size first_granule = start >> ZLOC_REGISTRY_GRANULE_LOG2;
+	zloc_size last_granule = (end - 1) >> ZLOC_REGISTRY_GRANULE_LOG2;
+	//Make all the nodes first so that running out of memory doesn't leave the pool half registered
+	for (zloc_size granule = first_granule; record && granule <= last_granule; ++granule) {
+		if (!zloc__registry_slot(registry, granule, 1)) {
+			record->next = registry->free_records;
+			registry->free_records = record;
+			record = 0;
+		}
+	}
+	if (!record) {
+		zloc__unlock_thread_access(registry);
+		return 0;
+	}
+	record->allocator = allocator;
+	record->pool = pool;
+	record->start = start;
+	record->end = end;
+	record->prev = prev;
+	record->next = next;
+	if (next) {
+		next->prev = record;
+	}
+	//The record is filled in before it's linked in so a lookup never sees it half done
+	if (prev) {
+		zloc__registry_store(prev->next, record);
+	} else {
+		registry->first = record;
+	}
+	for (zloc_size granule = first_granule; granule <= last_granule; ++granule) {
+		zloc_registered_pool **slot = zloc__registry_slot(registry, granule, 0);
+		if (!*slot || (*slot)->start > start) {
+			zloc__registry_store(*slot, record);
+		}
+	}
+	registry->pool_count++;
+	zloc__unlock_thread_access(registry);
+	return 1;
+}
+
+//Take a pool out of the registry, do this before zloc_RemovePool and once nothing is going to free into it
+zloc_bool zloc_UnregisterPool(zloc_pool_registry *registry, zloc_pool *pool) {
+	zloc__lock_thread_access(registry);
+	zloc_registered_pool *record = zloc__registry_find(registry, (zloc_size)(uintptr_t)pool);
+	if (!record || record->pool != pool) {
+		zloc__unlock_thread_access(registry);
+		return 0;
+	}
+	zloc_size last_granule = (record->end - 1) >> ZLOC_REGISTRY_GRANULE_LOG2;
+	for (zloc_size granule = record->start >> ZLOC_REGISTRY_GRANULE_LOG2; granule <= last_granule; ++granule) {
+		zloc_registered_pool **slot = zloc__registry_slot(registry, granule, 0);
+		if (*slot == record) {
+			//The next pool up is the lowest one left in the granule if it starts inside it
+			zloc_registered_pool *next = record->next;
+			zloc__registry_store(*slot, next && next->start < ((granule + 1) << ZLOC_REGISTRY_GRANULE_LOG2) ? next : 0);
+		}
+	}
+	if (record->next) {
+		record->next->prev = record->prev;
+	}
+	if (record->prev) {
+		zloc__registry_store(record->prev->next, record->next);
+	} else {
+		registry->first = record->next;
+	}
+	record->next = registry->free_records;
+	registry->free_records = record;
+	registry->pool_count--;
+	zloc__unlock_thread_access(registry);
+	return 1;
+}
+
+//Find the pool an allocation is in and optionally the allocator that owns it. Returns 0 if it isn't in any registered pool.
+zloc_pool *zloc_LookupPool(const zloc_pool_registry *registry, const void *allocation, zloc_allocator **allocator) {
+	zloc_registered_pool *record = zloc__registry_find(registry, (zloc_size)(uintptr_t)allocation);
+	if (!record) {
+		return 0;
+	}
+	if (allocator) {
+		*allocator = record->allocator;
+	}
+	return record->pool;
+}
+
+//Free an allocation from whichever registered allocator it came from
+int zloc_RegistryFree(zloc_pool_registry *registry, void *allocation) {
+	if (!allocation) {
+		return 0;
+	}
+	zloc_allocator *allocator;
+	if (!zloc_LookupPool(registry, allocation, &allocator)) {
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Tried to free memory that isn't in any registered pool.\n", ZLOC_ERROR_NAME);
+		return 0;
+	}
+	return zloc_Free(allocator, allocation);
+}
+
+#ifdef ZLOC_ENABLE_NUMA
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__) && (!defined(__STRICT_ANSI__) || defined(_GNU_SOURCE) || defined(_DEFAULT_SOURCE))
+//syscall is only declared when the GNU/BSD extensions are, so with -std=c99 and the like define _GNU_SOURCE too
+#include <sys/syscall.h>
+#define zloc__LINUX_NUMA
+//glibc's getcpu goes through the vDSO so it doesn't enter the kernel, it's had it since 2.29. Before that it's a
+//system call.
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#if defined(__USE_GNU)
+#include <sched.h>
+#define zloc__GETCPU
+#elif !defined(__cplusplus)
+//Only declared with _GNU_SOURCE but it's in libc either way
+extern int getcpu(unsigned int *cpu, unsigned int *node);
+#define zloc__GETCPU
+#endif
+#endif
+#endif
+#if defined(MAP_ANONYMOUS)
+#define zloc__MAP_ANONYMOUS MAP_ANONYMOUS
+#elif defined(MAP_ANON)
+#define zloc__MAP_ANONYMOUS MAP_ANON
+#endif
+
+//Allocation counters are bumped without any lock held
+#if defined(ZLOC_THREAD_SAFE) && (defined(__GNUC__) || defined(__clang__))
+#define zloc__numa_count(counter) __atomic_fetch_add(&(counter), 1, __ATOMIC_RELAXED)
+#else
+#define zloc__numa_count(counter) ((counter)++)
+#endif
+
+#define zloc__MPOL_BIND 2
+#define zloc__MPOL_MF_MOVE (1 << 1)
+
+/*
+	Ask the kernel to keep the pages of the memory on the node, moving any that have already been faulted in somewhere
+	else. Only whole pages can be bound so any partial page at either end is left where it is. Calls mbind directly
+	so that there's no need to link with libnuma.
+*/
+static zloc_bool zloc__bind_to_numa_node(void *memory, zloc_size size, zloc_uint node) {
+	#if defined(zloc__LINUX_NUMA) && defined(SYS_mbind)
+	zloc_size page_size = zloc__page_size();
+	zloc_size start = zloc__align_size_up((zloc_size)(uintptr_t)memory, page_size);
+	zloc_size end = ((zloc_size)(uintptr_t)memory + size) & ~(page_size - 1);
+	if (end <= start) {
+		return 0;
+	}
+	unsigned long mask[ZLOC_NUMA_MAX_NODES / (sizeof(unsigned long) * 8) + 1];
+	memset(mask, 0, sizeof(mask));
+	mask[node / (sizeof(unsigned long) * 8)] |= 1ul << (node % (sizeof(unsigned long) * 8));
+	//The kernel takes one off maxnode so add one to it
+	return syscall(SYS_mbind, (void*)start, (unsigned long)(end - start), zloc__MPOL_BIND, mask, (unsigned long)(sizeof(mask) * 8 + 1), zloc__MPOL_MF_MOVE) == 0;
+	#else
+	(void)memory; (void)size; (void)node;
+	return 0;
+	#endif
+}
+
+static void zloc__unmap_numa_pool(void *memory, zloc_size size) {
+	zloc__unpoison_memory(memory, size);
+	#ifdef _WIN32
+	(void)size;
+	VirtualFree(memory, 0, MEM_RELEASE);
+	#else
+	munmap(memory, size);
+	#endif
+}
+
+//The node of the calling thread, or the node after it if the allocator has fewer nodes then the machine
+static inline zloc_uint zloc__numa_home_node(const zloc_numa_allocator *numa) {
+	return (zloc_uint)ZLOC_NUMA_CURRENT_NODE() % numa->node_count;
+}
+
+//Try the home node first and then each of the others in turn
+static void *zloc__numa_allocate(zloc_numa_allocator *numa, zloc_uint home, zloc_size size) {
+	for (zloc_uint i = 0; i != numa->node_count; ++i) {
+		zloc_numa_node *numa_node = &numa->nodes[(home + i) % numa->node_count];
+		if (!numa_node->allocator) {
+			continue;
+		}
+		void *allocation = zloc_Allocate(numa_node->allocator, size);
+		if (allocation) {
+			if (i == 0) {
+				zloc__numa_count(numa_node->local_allocations);
+			} else {
+				zloc__numa_count(numa_node->remote_allocations);
+			}
+			return allocation;
+		}
+	}
+	return 0;
+}
+
+//The first pool on a node also holds the node's allocator so only the part after it is registered
+static void zloc__register_numa_pool(zloc_pool_registry *registry, zloc_numa_node *numa_node, zloc_size index) {
+	zloc_numa_pool *pool = &numa_node->pools[index];
+	if (index == 0) {
+		zloc_RegisterPool(registry, numa_node->allocator, zloc_GetPool(numa_node->allocator), pool->size - zloc_AllocatorSize());
+	} else {
+		zloc_RegisterPool(registry, numa_node->allocator, (zloc_pool*)pool->memory, pool->size);
+	}
+}
+
+static void zloc__unregister_numa_pool(zloc_pool_registry *registry, zloc_numa_node *numa_node, zloc_size index) {
+	zloc_UnregisterPool(registry, index == 0 ? zloc_GetPool(numa_node->allocator) : (zloc_pool*)numa_node->pools[index].memory);
+}
+
+static zloc_bool zloc__add_numa_pool(zloc_numa_allocator *numa, zloc_uint node, void *memory, zloc_size size, zloc_bool mapped, zloc_bool bound) {
+	zloc__lock_thread_access(numa);
+	zloc_numa_node *numa_node = &numa->nodes[node];
+	if (numa_node->pool_count == ZLOC_NUMA_MAX_POOLS) {
+		zloc__unlock_thread_access(numa);
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Node %u already has ZLOC_NUMA_MAX_POOLS pools.\n", ZLOC_ERROR_NAME, node);
+		return 0;
+	}
+	//Record the pool before anything can be allocated from it so that zloc_NumaFree can always find it
+	zloc_numa_pool *pool = &numa_node->pools[numa_node->pool_count++];
+	pool->memory = memory;
+	pool->size = size;
+	pool->mapped = mapped;
+	pool->bound = bound;
+	zloc_bool added;
+	if (!numa_node->allocator) {
+		numa_node->allocator = zloc_InitialiseAllocatorWithPool(memory, size);
+		added = numa_node->allocator != 0;
+	} else {
+		added = zloc_AddPool(numa_node->allocator, memory, size) != 0;
+	}
+	if (!added) {
+		numa_node->pool_count--;
+	} else if (numa->registry) {
+		zloc__register_numa_pool(numa->registry, numa_node, numa_node->pool_count - 1);
+	}
+	zloc__unlock_thread_access(numa);
+	return added;
+}
+
+zloc_uint zloc_NumaNodeCount(void) {
+	zloc_uint count = 1;
+	#if defined(_WIN32)
+	ULONG highest_node;
+	if (GetNumaHighestNodeNumber(&highest_node)) {
+		count = (zloc_uint)highest_node + 1;
+	}
+	#elif defined(__linux__)
+	FILE *file = fopen("/sys/devices/system/node/online", "r");
+	if (file) {
+		//A list of ranges like "0-1,3", the highest number is the last node
+		unsigned int node;
+		char separator;
+		while (fscanf(file, "%u", &node) == 1) {
+			count = zloc__Max(count, node + 1);
+			if (fscanf(file, "%c", &separator) != 1 || (separator != '-' && separator != ',')) {
+				break;
+			}
+		}
+		fclose(file);
+	}
+	#endif
+	return zloc__Min(count, (zloc_uint)ZLOC_NUMA_MAX_NODES);
+}
+
+zloc_uint zloc_CurrentNumaNode(void) {
+	#if defined(_WIN32)
+	PROCESSOR_NUMBER processor;
+	USHORT node;
+	GetCurrentProcessorNumberEx(&processor);
+	return GetNumaProcessorNodeEx(&processor, &node) ? (zloc_uint)node : 0;
+	#elif defined(zloc__GETCPU)
+	unsigned int cpu, node;
+	return getcpu(&cpu, &node) == 0 ? (zloc_uint)node : 0;
+	#elif defined(zloc__LINUX_NUMA) && defined(SYS_getcpu)
+	unsigned int cpu, node;
+	return syscall(SYS_getcpu, &cpu, &node, 0) == 0 ? (zloc_uint)node : 0;
+	#else
+	return 0;
+	#endif
+}
+
+/*
+	Pass 0 for the node count to use however many nodes the machine has, which is 1 if it doesn't have NUMA or the
+	node count can't be found out. If you ask for more nodes then the machine has then the extra nodes still work but
+	their pools won't be bound to anything.
+*/
+void zloc_InitialiseNumaAllocator(zloc_numa_allocator *numa, zloc_uint node_count) {
+	memset(numa, 0, sizeof(zloc_numa_allocator));
+	numa->node_count = node_count ? zloc__Min(node_count, (zloc_uint)ZLOC_NUMA_MAX_NODES) : zloc_NumaNodeCount();
+}
+
+/*
+	Add memory you've allocated yourself as a pool on a node. The whole pages of the memory are bound to the node and
+	moved there if they're already somewhere else. If they can't be bound (no NUMA, or no permission) the pool is still
+	added and used for the node, check bound_pools in zloc_GetNumaNodeStats if it matters. The first pool added to a
+	node also holds the node's allocator so it needs to be bigger then zloc_AllocatorSize().
+*/
+zloc_bool zloc_AddNumaPool(zloc_numa_allocator *numa, zloc_uint node, void *memory, zloc_size size) {
+	if (node >= numa->node_count) {
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Tried to add a pool to node %u but the allocator only has %u nodes.\n", ZLOC_ERROR_NAME, node, numa->node_count);
+		return 0;
+	}
+	return zloc__add_numa_pool(numa, node, memory, size, 0, zloc__bind_to_numa_node(memory, size, node));
+}
+
+/*
+	Map new memory for a pool on the node. The memory is bound before anything touches it so every page is faulted in
+	on the node. Size is rounded up to a whole number of pages. Returns the pool memory or 0 if it couldn't be mapped.
+*/
+void *zloc_CreateNumaPool(zloc_numa_allocator *numa, zloc_uint node, zloc_size size) {
+	if (node >= numa->node_count) {
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Tried to create a pool on node %u but the allocator only has %u nodes.\n", ZLOC_ERROR_NAME, node, numa->node_count);
+		return 0;
+	}
+	size = zloc__align_size_up(size, zloc__page_size());
+	#ifdef _WIN32
+	void *memory = VirtualAllocExNuma(GetCurrentProcess(), 0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+	zloc_bool bound = memory != 0;
+	if (!memory) {
+		memory = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+	#elif defined(zloc__MAP_ANONYMOUS)
+	void *memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | zloc__MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		memory = 0;
+	}
+	zloc_bool bound = memory ? zloc__bind_to_numa_node(memory, size, node) : 0;
+	#else
+	//No anonymous mappings without the GNU/BSD extensions, use zloc_AddNumaPool instead
+	void *memory = 0;
+	zloc_bool bound = 0;
+	#endif
+	if (!memory) {
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Unable to map %zu bytes for a pool on node %u.\n", ZLOC_ERROR_NAME, (size_t)size, node);
+		return 0;
+	}
+	if (!zloc__add_numa_pool(numa, node, memory, size, 1, bound)) {
+		zloc__unmap_numa_pool(memory, size);
+		return 0;
+	}
+	return memory;
+}
+
+/*
+	Register the pools of every node in the registry, and any that are added later, so that zloc_NumaFree,
+	zloc_NumaReallocate and zloc_NumaNodeOf find an allocation's node with a registry lookup instead of checking every
+	pool in turn. The registry can be shared with other allocators. Pass 0 to unregister them again.
+*/
+void zloc_SetNumaPoolRegistry(zloc_numa_allocator *numa, zloc_pool_registry *registry) {
+	zloc__lock_thread_access(numa);
+	for (zloc_uint node = 0; node != numa->node_count; ++node) {
+		zloc_numa_node *numa_node = &numa->nodes[node];
+		for (zloc_size i = 0; i != numa_node->pool_count; ++i) {
+			if (numa->registry) {
+				zloc__unregister_numa_pool(numa->registry, numa_node, i);
+			}
+			if (registry) {
+				zloc__register_numa_pool(registry, numa_node, i);
+			}
+		}
+	}
+	numa->registry = registry;
+	zloc__unlock_thread_access(numa);
+}
+
+//Unmap all the pools made with zloc_CreateNumaPool and forget about the rest. Nothing can be in use any more.
+void zloc_ReleaseNumaPools(zloc_numa_allocator *numa) {
+	for (zloc_uint node = 0; node != numa->node_count; ++node) {
+		zloc_numa_node *numa_node = &numa->nodes[node];
+		for (zloc_size i = 0; i != numa_node->pool_count; ++i) {
+			if (numa->registry) {
+				zloc__unregister_numa_pool(numa->registry, numa_node, i);
+			}
+			if (numa_node->pools[i].mapped) {
+				zloc__unmap_numa_pool(numa_node->pools[i].memory, numa_node->pools[i].size);
+			}
+		}
+		memset(numa_node, 0, sizeof(zloc_numa_node));
+	}
+}
+
+//Allocate from the calling thread's node, only going to other nodes when all of its pools are full
+void *zloc_NumaAllocate(zloc_numa_allocator *numa, zloc_size size) {
+	return zloc__numa_allocate(numa, zloc__numa_home_node(numa), size);
+}
+
+//Same as zloc_NumaAllocate but prefer the node given rather then the calling thread's node
+void *zloc_NumaAllocateOnNode(zloc_numa_allocator *numa, zloc_uint node, zloc_size size) {
+	ZLOC_ASSERT(node < numa->node_count);
+	return zloc__numa_allocate(numa, node, size);
+}
+
+/*
+	Resize in place on the node the allocation is on if possible, otherwise move it to the calling thread's node, or
+	any other node with room.
+*/
+void *zloc_NumaReallocate(zloc_numa_allocator *numa, void *allocation, zloc_size size) {
+	if (!allocation) {
+		return zloc_NumaAllocate(numa, size);
+	}
+	int node = zloc_NumaNodeOf(numa, allocation);
+	if (node < 0) {
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Tried to reallocate memory that isn't in any of the NUMA pools.\n", ZLOC_ERROR_NAME);
+		return 0;
+	}
+	zloc_allocator *allocator = numa->nodes[node].allocator;
+	if (!size) {
+		zloc_Free(allocator, allocation);
+		return 0;
+	}
+	void *result = zloc_Reallocate(allocator, allocation, size);
+	if (!result) {
+		result = zloc_NumaAllocate(numa, size);
+		if (result) {
+			zloc__copy_memory(result, allocation, zloc__Min(size, zloc_UsableSize(allocation)));
+			zloc_Free(allocator, allocation);
+		}
+	}
+	return result;
+}
+
+int zloc_NumaFree(zloc_numa_allocator *numa, void *allocation) {
+	if (!allocation) {
+		return 0;
+	}
+	int node = zloc_NumaNodeOf(numa, allocation);
+	if (node < 0) {
+		ZLOC_PRINT_ERROR(ZLOC_ERROR_COLOR"%s: Tried to free memory that isn't in any of the NUMA pools.\n", ZLOC_ERROR_NAME);
+		return 0;
+	}
+	return zloc_Free(numa->nodes[node].allocator, allocation);
+}
+
+//The node whose pools the allocation is in, or -1 if it isn't in any of them
+int zloc_NumaNodeOf(const zloc_numa_allocator *numa, const void *allocation) {
+	zloc_allocator *allocator;
+	if (numa->registry && zloc_LookupPool(numa->registry, allocation, &allocator)) {
+		for (zloc_uint node = 0; node != numa->node_count; ++node) {
+			if (numa->nodes[node].allocator == allocator) {
+				return (int)node;
+			}
+		}
+	}
+	//Without a registry, or for a pool the registry didn't have room for, check the pools one by one
+	for (zloc_uint node = 0; node != numa->node_count; ++node) {
+		const zloc_numa_node *numa_node = &numa->nodes[node];
+		for (zloc_size i = 0; i != numa_node->pool_count; ++i) {
+			const char *memory = (const char*)numa_node->pools[i].memory;
+			if ((const char*)allocation >= memory && (const char*)allocation < memory + numa_node->pools[i].size) {
+				return (int)node;
+			}
+		}
+	}
+	return -1;
+}
+
+zloc_numa_stats zloc_GetNumaNodeStats(zloc_numa_allocator *numa, zloc_uint node) {
+	zloc_numa_stats stats;
+	memset(&stats, 0, sizeof(zloc_numa_stats));
+	if (node >= numa->node_count) {
+		return stats;
+	}
+	zloc_numa_node *numa_node = &numa->nodes[node];
+	stats.pools = numa_node->pool_count;
+	for (zloc_size i = 0; i != numa_node->pool_count; ++i) {
+		stats.bound_pools += numa_node->pools[i].bound ? 1 : 0;
+	}
+	stats.local_allocations = numa_node->local_allocations;
+	stats.remote_allocations = numa_node->remote_allocations;
+	if (numa_node->allocator) {
+		zloc__lock_thread_access(numa_node->allocator);
+		stats.capacity = numa_node->allocator->stats.capacity;
+		stats.free = numa_node->allocator->stats.free;
+		stats.blocks_in_use = (zloc_size)numa_node->allocator->stats.blocks_in_use;
+		zloc__unlock_thread_access(numa_node->allocator);
+	}
+	return stats;
+}
+#endif
+
+/*
+	Builds the report from the bitmaps and the free byte counters of each segregated list so it costs O(classes)
+	rather then O(blocks). The only list that gets walked is the highest non-empty one, which is where the largest free
+	block has to be. For remote allocators the sizes are remote sizes.
+*/
+zloc__no_sanitize void zloc_GetFragmentationReport(zloc_allocator *allocator, zloc_fragmentation_report *report) {
+	memset(report, 0, sizeof(zloc_fragmentation_report));
+	zloc__lock_thread_access(allocator);
+	memcpy(report->free_bytes_by_class, allocator->free_list_bytes, sizeof(report->free_bytes_by_class));
+	report->free_blocks = allocator->stats.free_blocks;
+	zloc_fl_bitmap first_level_bitmap = allocator->first_level_bitmap;
+	while (first_level_bitmap) {
+		zloc_index fli = zloc__scan_forward(first_level_bitmap);
+		first_level_bitmap &= ~(ZLOC_ONE << fli);
+		zloc_sl_bitmap second_level_bitmap = allocator->second_level_bitmaps[fli];
+		while (second_level_bitmap) {
+			zloc_index sli = zloc__scan_forward(second_level_bitmap);
+			second_level_bitmap &= ~(1U << sli);
+			report->total_free += allocator->free_list_bytes[fli][sli];
+		}
+	}
+	zloc_index fli = zloc__scan_reverse(allocator->first_level_bitmap);
+	if (fli > -1) {
+		zloc_index sli = zloc__scan_reverse(allocator->second_level_bitmaps[fli]);
+		zloc_header *block = allocator->segregated_lists[fli][sli];
+		while (block != zloc__null_block(allocator)) {
+			report->largest_free_block = zloc__Max(report->largest_free_block, zloc__do_size_class_callback(block));
+			block = block->next_free_block;
+		}
+	}
+	zloc__unlock_thread_access(allocator);
+	report->external_fragmentation = report->total_free ? 1.f - (float)((double)report->largest_free_block / (double)report->total_free) : 0.f;
+}
+
+static inline zloc__no_sanitize void zloc__heap_dump_block(const zloc_pool *pool, zloc_header *block, zloc_bool remote, zloc_heap_dump_block *record) {
+	if (remote) {
+		//Remote block extensions always start with the size and memory offset
+		const zloc_remote_header *remote_block = (const zloc_remote_header*)zloc_BlockUserExtensionPtr(block);
+		record->offset = remote_block->memory_offset;
+		record->size = remote_block->size;
+	} else {
+		record->offset = (uint64_t)((char*)zloc__block_user_ptr(block) - (char*)pool);
+		record->size = zloc__block_size(block);
+	}
+	record->flags = zloc__is_free_block(block) ? 0 : zloc_heap_dump_block_used;
+	record->tag = zloc__is_free_block(block) ? 0 : zloc__block_tag(block);
+}
+
+/*
+	Write every block in a pool to a file in the heap dump format so that it can be looked at offline with heapview.c.
+	For remote pools pass the block memory you gave to zloc_AddRemotePool and the dump will hold the remote offsets and
+	sizes instead. The allocator is locked while the pool is walked. Returns 0 if the file couldn't be written to.
+*/
+zloc_bool zloc_WriteHeapDump(zloc_allocator *allocator, const zloc_pool *pool, FILE *file) {
+	zloc_bool remote = allocator->get_block_size_callback != zloc__block_size;
+	zloc_heap_dump_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ZLOC_HEAP_DUMP_MAGIC, sizeof(header.magic));
+	header.version = ZLOC_HEAP_DUMP_VERSION;
+	header.flags = remote ? zloc_heap_dump_remote : 0;
+	header.block_overhead = remote ? 0 : zloc__BLOCK_POINTER_OFFSET;
+	header.minimum_allocation_size = allocator->minimum_allocation_size;
+	zloc__lock_thread_access(allocator);
+	zloc_header *block = zloc__first_block_in_pool(pool);
+	zloc_heap_dump_block record;
+	while (!zloc__is_last_block_in_pool(block)) {
+		zloc__heap_dump_block(pool, block, remote, &record);
+		header.pool_size = zloc__Max(header.pool_size, record.offset + record.size);
+		header.block_count++;
+		block = zloc__next_physical_block(block);
+	}
+	zloc_bool result = fwrite(&header, sizeof(header), 1, file) == 1;
+	block = zloc__first_block_in_pool(pool);
+	while (result && !zloc__is_last_block_in_pool(block)) {
+		zloc__heap_dump_block(pool, block, remote, &record);
+		result = fwrite(&record, sizeof(record), 1, file) == 1;
+		block = zloc__next_physical_block(block);
+	}
+	zloc__unlock_thread_access(allocator);
+	return result;
+}
+
+//Find the group for a size and tag in the groups so far, which are kept in key order while the pools are walked
+static zloc_leak_group *zloc__leak_group(zloc_leak_report *report, zloc_size block_size, zloc_uint tag) {
+	zloc_size low = 0;
+	zloc_size high = report->group_count;
+	while (low < high) {
+		zloc_size middle = (low + high) / 2;
+		const zloc_leak_group *group = &report->groups[middle];
+		if (group->block_size < block_size || (group->block_size == block_size && group->tag < tag)) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	if (low < report->group_count && report->groups[low].block_size == block_size && report->groups[low].tag == tag) {
+		return &report->groups[low];
+	}
+	if (report->group_count == report->max_groups) {
+		return 0;
+	}
+	memmove(report->groups + low + 1, report->groups + low, (report->group_count - low) * sizeof(zloc_leak_group));
+	report->group_count++;
+	zloc_leak_group *group = &report->groups[low];
+	memset(group, 0, sizeof(zloc_leak_group));
+	group->block_size = block_size;
+	group->tag = tag;
+	return group;
+}
+
+static int zloc__compare_leak_groups(const void *a, const void *b) {
+	zloc_size a_bytes = ((const zloc_leak_group*)a)->total_bytes;
+	zloc_size b_bytes = ((const zloc_leak_group*)b)->total_bytes;
+	return a_bytes < b_bytes ? 1 : a_bytes > b_bytes ? -1 : 0;
+}
+
+/*
+	List every allocation that's still live in the pools, grouped by block size and tag and sorted by the total bytes
+	in each group. Each pool is walked once and the allocator is only locked while a pool is being walked, so this can
+	be run in a live process as well as at shutdown. The callback, if set, is called for each allocation with the
+	allocator locked so it mustn't call back into the allocator. For remote pools the sizes are the remote sizes and
+	the allocation passed to the callback is the block extension.
+*/
+void zloc_CreateLeakReport(zloc_allocator *allocator, zloc_pool **pools, zloc_size pool_count, zloc_leak_report *report) {
+	zloc_bool remote = allocator->get_block_size_callback != zloc__block_size;
+	report->group_count = 0;
+	report->allocations = 0;
+	report->bytes = 0;
+	report->ungrouped_allocations = 0;
+	report->ungrouped_bytes = 0;
+	for (zloc_size i = 0; i != pool_count; ++i) {
+		zloc__lock_thread_access(allocator);
+		for (zloc_header *block = zloc__first_block_in_pool(pools[i]); !zloc__is_last_block_in_pool(block); block = zloc__next_physical_block(block)) {
+			if (zloc__is_free_block(block)) {
+				continue;
+			}
+			zloc_size size = zloc__do_size_class_callback(block);
+			zloc_uint tag = zloc__block_tag(block);
+			zloc_leak_group *group = zloc__leak_group(report, size, tag);
+			if (group) {
+				group->count++;
+				group->total_bytes += size;
+			} else {
+				report->ungrouped_allocations++;
+				report->ungrouped_bytes += size;
+			}
+			report->allocations++;
+			report->bytes += size;
+			if (report->callback) {
+				report->callback(report->user_data, remote ? zloc_BlockUserExtensionPtr(block) : zloc__block_user_ptr(block), size, tag);
+			}
+		}
+		zloc__unlock_thread_access(allocator);
+	}
+	qsort(report->groups, report->group_count, sizeof(zloc_leak_group), zloc__compare_leak_groups);
+}
+
+/*
+	Standard callbacks, you can copy paste these to replace with your own as needed to add any extra functionality
+	that you might need
+*/
+void zloc__remote_merge_next_callback(void *remote_user_data, zloc_header *block, zloc_header *next_block) {
+	zloc_remote_header *remote_block = (zloc_remote_header*)zloc_BlockUserExtensionPtr(block);
+	zloc_remote_header *next_remote_block = (zloc_remote_header*)zloc_BlockUserExtensionPtr(next_block);
+	remote_block->size += next_remote_block->size;
+	next_remote_block->memory_offset = 0;
+	next_remote_block->size = 0;
+}
+
+void zloc__remote_merge_prev_callback(void *remote_user_data, zloc_header *prev_block, zloc_header *block) {
+	zloc_remote_header *remote_block = (zloc_remote_header*)zloc_BlockUserExtensionPtr(block);
+	zloc_remote_header *prev_remote_block = (zloc_remote_header*)zloc_BlockUserExtensionPtr(prev_block);
+	prev_remote_block->size += remote_block->size;
+	remote_block->memory_offset = 0;
+	remote_block->size = 0;
+}
+
+zloc_size zloc__get_remote_size(const zloc_header *block) {
+	zloc_remote_header *remote_block = (zloc_remote_header*)zloc_BlockUserExtensionPtr(block);
+	return remote_block->size;
+}
+
+void *zloc_Allocate(zloc_allocator *allocator, zloc_size size) {
+	#ifdef ZLOC_ENABLE_GUARD_PAGES
+	if (allocator->guard_pages) {
+		return zloc__allocate_guarded(allocator, size, 0, 0);
+	}
+	#endif
+	return zloc__allocate(allocator, size, 0, 0, 0);
+}
+
+//Same as zloc_Allocate but the allocation is all zero. With ZLOC_ENABLE_ZERO_TRACKING blocks that are known to be zero
+//already aren't cleared again
+void *zloc_AllocateZeroed(zloc_allocator *allocator, zloc_size size) {
+	#ifdef ZLOC_ENABLE_GUARD_PAGES
+	if (allocator->guard_pages) {
+		void *allocation = zloc__allocate_guarded(allocator, size, 0, 0);
+		if (allocation) {
+			memset(allocation, 0, size);
+		}
+		return allocation;
+	}
+	#endif
+	return zloc__allocate(allocator, size, 0, 0, 1);
+}
+
+void *zloc_AllocateSizeReturning(zloc_allocator *allocator, zloc_size size, zloc_size *usable_size) {
+	#ifdef ZLOC_ENABLE_GUARD_PAGES
+	if (allocator->guard_pages) {
+		//Anything past the size asked for is the guard page, so that's all there is to use
+		void *guarded = zloc__allocate_guarded(allocator, size, 0, 0);
+		if (usable_size) {
+			*usable_size = guarded ? size : 0;
+		}
+		return guarded;
+	}
+	#endif
+	void *allocation = zloc__allocate(allocator, size, 0, 0, 0);
+	if (usable_size) {
+		*usable_size = zloc_UsableSize(allocation);
+	}
+	return allocation;
+}
+
+//The number of bytes that can actually be used in an allocation. This will be at least the size that was requested
+//but can be more due to the size being rounded up or the block being too small to split when it was allocated.
+zloc_size zloc_UsableSize(const void *allocation) {
+	if (!allocation) {
+		return 0;
+	}
+	return zloc__block_size(zloc__block_from_allocation(allocation));
+}
+
+void zloc_SetBlockExtensionSize(zloc_allocator *allocator, zloc_size size) {
+	ZLOC_ASSERT(allocator->block_extension_size == 0);	//You cannot change this once set
+	allocator->block_extension_size = zloc__align_size_up(size, zloc__MEMORY_ALIGNMENT);
+}
+
+zloc_size zloc_CalculateRemoteBlockPoolSize(zloc_allocator *allocator, zloc_size remote_pool_size) {
+	ZLOC_ASSERT(allocator->block_extension_size);	//You must set the block extension size first
+	ZLOC_ASSERT(allocator->minimum_allocation_size);		//You must set the number of bytes per block
+	return (sizeof(zloc_header) + allocator->block_extension_size) * (remote_pool_size / allocator->minimum_allocation_size) + zloc__BLOCK_POINTER_OFFSET;
+}
+
+void zloc_AddRemotePool(zloc_allocator *allocator, void *block_memory, zloc_size block_memory_size, zloc_size remote_pool_size) {
+	ZLOC_ASSERT(allocator->add_pool_callback);	//You must set all the necessary callbacks to handle remote memory management
 	ZLOC_ASSERT(allocator->get_block_size_callback);
 	ZLOC_ASSERT(allocator->merge_next_callback);
 	ZLOC_ASSERT(allocator->merge_prev_callback);
@@ -1319,7 +4211,7 @@ zloc_allocator *zloc_InitialiseAllocatorForRemote(void *memory) {
 void *zloc_AllocateRemote(zloc_allocator *allocator, zloc_size remote_size) {
 	ZLOC_ASSERT(allocator->minimum_allocation_size > 0);
 	remote_size = zloc__Max(remote_size, allocator->minimum_allocation_size);
-	void* allocation = zloc__allocate(allocator, (remote_size / allocator->minimum_allocation_size) * (allocator->block_extension_size + zloc__BLOCK_POINTER_OFFSET), remote_size);
+	void* allocation = zloc__allocate(allocator, (remote_size / allocator->minimum_allocation_size) * (allocator->block_extension_size + zloc__BLOCK_POINTER_OFFSET), remote_size, 0, 0);
 	return allocation ? (char*)allocation + zloc__MINIMUM_BLOCK_SIZE : 0;
 }
 
@@ -1334,7 +4226,7 @@ void *zloc__reallocate_remote(zloc_allocator *allocator, void *ptr, zloc_size si
 
 	if (!ptr) {
 		zloc__unlock_thread_access(allocator);
-		return zloc__allocate(allocator, size, remote_size);
+		return zloc__allocate(allocator, size, remote_size, 0, 0);
 	}
 
 	zloc_header *block = zloc__block_from_allocation(ptr);
@@ -1345,10 +4237,38 @@ void *zloc__reallocate_remote(zloc_allocator *allocator, void *ptr, zloc_size si
 	zloc_size adjusted_size = zloc__adjust_size(size, allocator->minimum_allocation_size, zloc__MEMORY_ALIGNMENT);
 	zloc_size combined_size = current_size + zloc__block_size(next_block);
 	zloc_size combined_remote_size = current_remote_size + zloc__do_size_class_callback(next_block);
+	if (remote_size > current_remote_size && !zloc__tag_has_room(allocator, zloc__block_tag(block), remote_size - current_remote_size)) {
+		zloc__unlock_thread_access(allocator);
+		return 0;
+	}
 	if ((!zloc__next_block_is_free(block) || adjusted_size > combined_size || remote_size > combined_remote_size) && (remote_size > current_remote_size)) {
+		if (allocator->move_block_callback && zloc__prev_is_free_block(block)) {
+			zloc_header *prev_block = block->prev_physical_block;
+			zloc_size backward_remote_size = zloc__do_size_class_callback(prev_block) + current_remote_size;
+			if (zloc__next_block_is_free(block)) {
+				backward_remote_size += zloc__do_size_class_callback(next_block);
+			}
+			//Size the block the same way zloc_AllocateRemote does, minimum_allocation_size only applies to the remote size
+			zloc_size block_size = zloc__adjust_size(size, zloc__MINIMUM_BLOCK_SIZE, zloc__MEMORY_ALIGNMENT);
+			if (block_size <= zloc__backward_growth_size(block) && remote_size <= backward_remote_size) {
+				//Grow backwards into the free previous block. The move callback fires before anything is merged so that
+				//both blocks still describe where the remote memory is and where it needs to move to. Note that the
+				//two ranges can overlap.
+				allocator->move_block_callback(allocator->remote_user_data, block, prev_block);
+				block = zloc__merge_for_backward_growth(allocator, block);
+				allocation = zloc__block_user_ptr(zloc__maybe_split_block(allocator, block, block_size, remote_size));
+				zloc__count_resize(allocator, current_remote_size, block);
+				zloc__tag_resize(allocator, current_remote_size, block);
+				zloc__unlock_thread_access(allocator);
+				return allocation;
+			}
+		}
 		zloc_header *new_block = zloc__find_free_block(allocator, size, remote_size);
 		if (new_block) {
+			(void)zloc__take_zero_flag(new_block);
 			allocation = zloc__block_user_ptr(new_block);
+			zloc__count_allocation(allocator, new_block);
+			zloc__tag_allocation(allocator, new_block, zloc__block_tag(block));
 		}
 
 		if (allocation) {
@@ -1359,15 +4279,21 @@ void *zloc__reallocate_remote(zloc_allocator *allocator, void *ptr, zloc_size si
 			zloc__lock_thread_access(allocator);
 		}
 	}
-	else {
+	else if (remote_size > current_remote_size) {
 		//Reallocation is possible
-		if (remote_size > current_remote_size)
-		{
-			zloc__merge_with_next_block(allocator, block);
-			zloc__mark_block_as_used(block);
-		}
+		zloc__merge_with_next_block(allocator, block);
+		zloc__mark_block_as_used(block);
 		zloc_header *split_block = zloc__maybe_split_block(allocator, block, adjusted_size, remote_size);
 		allocation = zloc__block_user_ptr(split_block);
+		zloc__count_resize(allocator, current_remote_size, block);
+		zloc__tag_resize(allocator, current_remote_size, block);
+	}
+	else {
+		//Size the block the same way zloc_AllocateRemote does, minimum_allocation_size only applies to the remote size
+		zloc_size block_size = zloc__adjust_size(size, zloc__MINIMUM_BLOCK_SIZE, zloc__MEMORY_ALIGNMENT);
+		allocation = zloc__block_user_ptr(zloc__shrink_block(allocator, block, block_size, remote_size));
+		zloc__count_resize(allocator, current_remote_size, block);
+		zloc__tag_resize(allocator, current_remote_size, block);
 	}
 
 	zloc__unlock_thread_access(allocator);
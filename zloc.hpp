@@ -0,0 +1,270 @@
+/*	Zest Allocator - C++ helpers
+
+This software is dual-licensed to the public domain and under the following license: you are granted a perpetual,
+irrevocable license to copy, modify, publish, and distribute this file as you see fit. See LICENSE for details.
+
+Thin C++ wrappers around zloc.h so standard containers can sit directly on zloc allocators. Include zloc.h with
+ZLOC_IMPLEMENTATION in one translation unit as normal, then include this file wherever you need the wrappers.
+
+	#include "zloc.hpp"
+
+	zloc::tlsf_resource resource(allocator);
+	std::pmr::vector<float> floats(&resource);
+
+	std::vector<float, zloc::stl_allocator<float, my_allocator_tag>> more_floats;
+
+See the README.md file for more details.
+*/
+
+#ifndef ZLOC_HPP_INCLUDE
+#define ZLOC_HPP_INCLUDE
+
+#include "zloc.h"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <memory>
+#include <type_traits>
+
+#if defined(__has_include)
+#if __has_include(<memory_resource>) && ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+#include <memory_resource>
+#define ZLOC_HAS_PMR
+#endif
+#endif
+
+namespace zloc {
+
+#if defined(__cpp_lib_allocate_at_least)
+template <typename Pointer> using allocation_result = std::allocation_result<Pointer>;
+#else
+//Stand in for std::allocation_result until C++23
+template <typename Pointer> struct allocation_result {
+	Pointer ptr;
+	std::size_t count;
+};
+#endif
+
+/*
+	An STL compatible allocator bound at compile time to a zloc_allocator through a tag type, so containers don't
+	carry an allocator pointer around. The tag just needs a static function returning the allocator to use:
+
+	struct render_heap {
+		static zloc_allocator *instance() { return render_allocator; }
+	};
+	std::vector<vertex, zloc::stl_allocator<vertex, render_heap>> vertices;
+
+	allocate_at_least hands back the real number of elements that fit in the block that was allocated, which
+	includes any slack left over from the allocator rounding the size up or deciding not to split the block.
+*/
+template <typename T, typename AllocatorTag>
+class stl_allocator {
+public:
+	typedef T value_type;
+	typedef std::size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type is_always_equal;
+	template <typename U> struct rebind { typedef stl_allocator<U, AllocatorTag> other; };
+
+	stl_allocator() noexcept {}
+	template <typename U> stl_allocator(const stl_allocator<U, AllocatorTag> &) noexcept {}
+
+	T *allocate(std::size_t count) {
+		if (count > max_size()) {
+			throw std::bad_alloc();
+		}
+		zloc_allocator *allocator = AllocatorTag::instance();
+		void *allocation = alignof(T) > zloc__MEMORY_ALIGNMENT ? zloc_AllocateAligned(allocator, count * sizeof(T), alignof(T)) : zloc_Allocate(allocator, count * sizeof(T));
+		if (!allocation) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(allocation);
+	}
+
+	allocation_result<T*> allocate_at_least(std::size_t count) {
+		T *allocation = allocate(count);
+		allocation_result<T*> result = { allocation, zloc_UsableSize(allocation) / sizeof(T) };
+		return result;
+	}
+
+	void deallocate(T *allocation, std::size_t) noexcept {
+		zloc_Free(AllocatorTag::instance(), allocation);
+	}
+
+	std::size_t max_size() const noexcept {
+		return zloc__MAXIMUM_BLOCK_SIZE / sizeof(T);
+	}
+};
+
+template <typename T, typename U, typename AllocatorTag>
+inline bool operator==(const stl_allocator<T, AllocatorTag> &, const stl_allocator<U, AllocatorTag> &) noexcept { return true; }
+
+template <typename T, typename U, typename AllocatorTag>
+inline bool operator!=(const stl_allocator<T, AllocatorTag> &, const stl_allocator<U, AllocatorTag> &) noexcept { return false; }
+
+#ifdef ZLOC_HAS_PMR
+
+/*
+	A memory resource that routes std::pmr containers through an existing zloc_allocator. Requests for an alignment
+	greater than the allocator's natural alignment go through zloc_AllocateAligned, everything else through
+	zloc_Allocate. The resource doesn't own the allocator.
+*/
+class tlsf_resource : public std::pmr::memory_resource {
+public:
+	explicit tlsf_resource(zloc_allocator *allocator) noexcept : allocator_(allocator) {}
+
+	zloc_allocator *allocator() const noexcept { return allocator_; }
+
+protected:
+	void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+		void *allocation = alignment > zloc__MEMORY_ALIGNMENT ? zloc_AllocateAligned(allocator_, bytes, alignment) : zloc_Allocate(allocator_, bytes);
+		if (!allocation) {
+			throw std::bad_alloc();
+		}
+		return allocation;
+	}
+
+	void do_deallocate(void *allocation, std::size_t, std::size_t) override {
+		zloc_Free(allocator_, allocation);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+		return this == &other;
+	}
+
+private:
+	zloc_allocator *allocator_;
+};
+
+/*
+	A memory resource on top of a zloc_linear_allocator_t. Deallocation is a no-op, memory comes back when you reset
+	the linear allocator (or roll it back to a marker). Chained linear allocators spill over as normal.
+*/
+class linear_resource : public std::pmr::memory_resource {
+public:
+	explicit linear_resource(zloc_linear_allocator_t *allocator) noexcept : allocator_(allocator) {}
+
+	zloc_linear_allocator_t *allocator() const noexcept { return allocator_; }
+
+protected:
+	void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+		//zloc_LinearAllocation only aligns to the pointer size so over allocate for anything stricter
+		std::size_t padding = alignment > sizeof(void*) ? alignment - 1 : 0;
+		void *allocation = zloc_LinearAllocation(allocator_, bytes + padding);
+		if (!allocation) {
+			throw std::bad_alloc();
+		}
+		if (!padding) {
+			return allocation;
+		}
+		std::uintptr_t address = reinterpret_cast<std::uintptr_t>(allocation);
+		return reinterpret_cast<void*>((address + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1));
+	}
+
+	void do_deallocate(void *, std::size_t, std::size_t) override {
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+		return this == &other;
+	}
+
+private:
+	zloc_linear_allocator_t *allocator_;
+};
+
+/*
+	A memory resource that owns its own zloc_allocator and grows it by pulling pools from an upstream resource when
+	it runs out of space. Every pool is handed back to upstream when the resource is destroyed. Allocation and freeing
+	are as thread safe as zloc.h is compiled to be, but growing the resource is not, so like
+	std::pmr::unsynchronized_pool_resource only share it between threads if you synchronise access yourself.
+*/
+class pool_resource : public std::pmr::memory_resource {
+public:
+	explicit pool_resource(std::size_t pool_size, std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+		: upstream_(upstream), pool_size_(pool_size), pools_(0) {
+		allocator_ = zloc_InitialiseAllocator(upstream_->allocate(zloc_AllocatorSize(), alignof(std::max_align_t)));
+	}
+
+	~pool_resource() override {
+		release();
+		upstream_->deallocate(allocator_, zloc_AllocatorSize(), alignof(std::max_align_t));
+	}
+
+	pool_resource(const pool_resource &) = delete;
+	pool_resource &operator=(const pool_resource &) = delete;
+
+	//Hands every pool back to upstream. Any allocations still in use from this resource become invalid.
+	void release() {
+		while (pools_) {
+			pool_link *next = pools_->next;
+			upstream_->deallocate(pools_, pools_->size, alignof(std::max_align_t));
+			pools_ = next;
+		}
+		zloc_InitialiseAllocator(allocator_);
+	}
+
+	zloc_allocator *allocator() const noexcept { return allocator_; }
+	std::pmr::memory_resource *upstream_resource() const noexcept { return upstream_; }
+
+protected:
+	void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+		void *allocation = allocate_from_pools(bytes, alignment);
+		if (!allocation) {
+			//Make sure a single large request always fits in the new pool, including any aligned gap
+			std::size_t minimum_size = sizeof(pool_link) + bytes + alignment * 2 + sizeof(zloc_header) * 4;
+			add_pool(pool_size_ > minimum_size ? pool_size_ : minimum_size);
+			allocation = allocate_from_pools(bytes, alignment);
+		}
+		if (!allocation) {
+			throw std::bad_alloc();
+		}
+		return allocation;
+	}
+
+	void do_deallocate(void *allocation, std::size_t, std::size_t) override {
+		zloc_Free(allocator_, allocation);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+		return this == &other;
+	}
+
+private:
+	//Sits at the start of every pool so they can be handed back to upstream later
+	struct pool_link {
+		pool_link *next;
+		std::size_t size;
+	};
+
+	void *allocate_from_pools(std::size_t bytes, std::size_t alignment) {
+		if (!pools_) {
+			return 0;
+		}
+		return alignment > zloc__MEMORY_ALIGNMENT ? zloc_AllocateAligned(allocator_, bytes, alignment) : zloc_Allocate(allocator_, bytes);
+	}
+
+	void add_pool(std::size_t size) {
+		pool_link *pool = static_cast<pool_link*>(upstream_->allocate(size, alignof(std::max_align_t)));
+		//The pool size has to be a multiple of the alignment, whatever size was asked for
+		if (!zloc_AddPool(allocator_, pool + 1, zloc__align_size_down(size - sizeof(pool_link), zloc__MEMORY_ALIGNMENT))) {
+			upstream_->deallocate(pool, size, alignof(std::max_align_t));
+			throw std::bad_alloc();
+		}
+		//Only linked in once the allocator has it, so a failed pool is never handed back twice
+		pool->next = pools_;
+		pool->size = size;
+		pools_ = pool;
+	}
+
+	std::pmr::memory_resource *upstream_;
+	std::size_t pool_size_;
+	pool_link *pools_;
+	zloc_allocator *allocator_;
+};
+
+#endif	//ZLOC_HAS_PMR
+
+}	//namespace zloc
+
+#endif	//ZLOC_HPP_INCLUDE